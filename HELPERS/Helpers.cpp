@@ -6,6 +6,623 @@
 
 #include "Helpers.h"
 
+namespace
+{
+   // runs Worker(uWorkerIndex) on uThreads threads, the calling thread being the worker 0
+   void RunWorkers(size_t uThreads, const std::function<void(size_t)>& Worker)
+   {
+      std::vector<std::thread> vecThreads;
+      for (size_t uWorker = 1; uWorker < uThreads; ++uWorker)
+         vecThreads.emplace_back(Worker, uWorker);
+      Worker(0);
+      for (std::thread& Thread : vecThreads)
+         Thread.join();
+   }
+
+   // adds the time spent in its scope to *pNanoseconds (nothing is measured if it's nullptr)
+   class ScopedTimer
+   {
+   public:
+      explicit ScopedTimer(uint64_t* pNanoseconds) : m_pNanoseconds(pNanoseconds)
+      {
+         if (m_pNanoseconds)
+            m_Start = std::chrono::steady_clock::now();
+      }
+
+      ~ScopedTimer()
+      {
+         if (m_pNanoseconds)
+            *m_pNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - m_Start).count();
+      }
+
+   private:
+      uint64_t* m_pNanoseconds;
+      std::chrono::steady_clock::time_point m_Start;
+   };
+
+   inline uint64_t* ReadDirTime(Directory::WalkStats* pStats) { return (pStats) ? &pStats->uReadDirNanoseconds : nullptr; }
+   inline uint64_t* StatTime(Directory::WalkStats* pStats) { return (pStats) ? &pStats->uStatNanoseconds : nullptr; }
+   inline void AddError(Directory::WalkStats* pStats) { if (pStats) ++pStats->uErrors; }
+}
+
+#ifdef LINUX
+namespace
+{
+   // record layout returned by the getdents64 system call (glibc doesn't export it)
+   struct LinuxDirent64
+   {
+      uint64_t       d_ino;
+      int64_t        d_off;
+      unsigned short d_reclen;
+      unsigned char  d_type;
+      char           d_name[1];
+   };
+
+   // large enough to read most folders with a single system call (readdir uses 32 KB)
+   constexpr size_t DENTS_BUFFER_SIZE = 128 * 1024;
+
+   // calls OnDent(const char* pszName, unsigned char ucType) for each entry of the folder except "." and ".."
+   // until it returns false (then ReadFolder returns false too)
+   template <typename Callback>
+   bool ReadFolder(int iDirFd, char* pBuffer, Callback&& OnDent, Directory::WalkStats* pStats = nullptr)
+   {
+      for (;;)
+      {
+         long lRead;
+         {
+            ScopedTimer Timer(ReadDirTime(pStats));
+            lRead = syscall(SYS_getdents64, iDirFd, pBuffer, DENTS_BUFFER_SIZE);
+         }
+         if (lRead <= 0)
+         {
+            if (lRead < 0)
+               AddError(pStats);
+            break;
+         }
+
+         for (long lPos = 0; lPos < lRead;)
+         {
+            const LinuxDirent64* pEntry = reinterpret_cast<const LinuxDirent64*>(pBuffer + lPos);
+            lPos += pEntry->d_reclen;
+
+            const char* pszName = pEntry->d_name;
+            if (pszName[0] == '.' && (pszName[1] == '\0' || (pszName[1] == '.' && pszName[2] == '\0')))
+               continue;
+
+            if (!OnDent(pszName, pEntry->d_type))
+               return false;
+         }
+      }
+      return true;
+   }
+
+   // descriptor of a folder shared by the tasks of its sub-folders, which open them relatively to it :
+   // it is closed once the last of them released it (an ancestor replaced meanwhile by a symbolic link
+   // can't send the walk out of the tree, and the lookup doesn't depend on the depth)
+   class FolderHandle
+   {
+   public:
+      FolderHandle(int iFd, bool bOwned) : m_iFd(iFd), m_bOwned(bOwned) {}
+      ~FolderHandle()
+      {
+         if (m_bOwned)
+            close(m_iFd);
+      }
+
+      FolderHandle(const FolderHandle&) = delete;
+      FolderHandle& operator=(const FolderHandle&) = delete;
+
+      inline int Get() const { return m_iFd; }
+
+   private:
+      const int m_iFd;
+      const bool m_bOwned; // the root's descriptor is closed by its owner
+   };
+   typedef std::shared_ptr<FolderHandle> FolderHandlePtr;
+
+   // the last component of a path built by the walks (never ends with a separator)
+   inline const char* GetLastName(const std::string& strPath)
+   {
+      return strPath.c_str() + strPath.rfind('/') + 1;
+   }
+
+   inline int OpenSubFolder(const FolderHandle& Parent, const char* pszName)
+   {
+      return openat(Parent.Get(), pszName, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+   }
+
+   // descriptors of the folders along a relative path, opened one component at a time without following
+   // symbolic links : the next path reuses the descriptors of the common prefix, so that moving to a
+   // sibling folder only opens that folder
+   class FolderChain
+   {
+   public:
+      explicit FolderChain(int iRootFd) : m_iRootFd(iRootFd) {}
+      ~FolderChain() { Truncate(0); }
+
+      FolderChain(const FolderChain&) = delete;
+      FolderChain& operator=(const FolderChain&) = delete;
+
+      // descriptor of the folder (the uLength first characters of the path, none for the root), -1 if it
+      // can't be opened
+      int Open(const char* pszPath, size_t uLength)
+      {
+         if (m_iRootFd < 0)
+            return -1;
+
+         size_t uDepth = 0;
+         for (; uDepth < m_vecLevels.size(); ++uDepth)
+         {
+            const size_t uEnd = m_vecLevels[uDepth].first;
+            if (uEnd > uLength || (uEnd < uLength && pszPath[uEnd] != '/')
+               || m_strPath.compare(0, uEnd, pszPath, uEnd) != 0)
+               break;
+         }
+         Truncate(uDepth);
+
+         for (size_t uStart = (uDepth > 0) ? m_vecLevels.back().first + 1 : 0; uStart < uLength;)
+         {
+            const char* pszSeparator = static_cast<const char*>(memchr(pszPath + uStart, '/', uLength - uStart));
+            const size_t uEnd = (pszSeparator) ? pszSeparator - pszPath : uLength;
+            if (uEnd > uStart)
+            {
+               const std::string strName(pszPath + uStart, uEnd - uStart);
+               const int iFd = openat(Get(), strName.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+               if (iFd < 0)
+                  return -1;
+               m_strPath.assign(pszPath, uEnd);
+               m_vecLevels.emplace_back(uEnd, iFd);
+            }
+            uStart = uEnd + 1;
+         }
+         return Get();
+      }
+
+   private:
+      inline int Get() const { return (m_vecLevels.empty()) ? m_iRootFd : m_vecLevels.back().second; }
+
+      void Truncate(size_t uDepth)
+      {
+         for (; m_vecLevels.size() > uDepth; m_vecLevels.pop_back())
+            close(m_vecLevels.back().second);
+         m_strPath.resize((uDepth > 0) ? m_vecLevels.back().first : 0);
+      }
+
+      const int m_iRootFd; // closed by its owner
+      std::string m_strPath; // of the deepest opened folder
+      std::vector<std::pair<size_t, int>> m_vecLevels; // end of each component in m_strPath, its descriptor
+   };
+
+   Directory::EntryType GetEntryType(mode_t Mode)
+   {
+      if (S_ISDIR(Mode))
+         return Directory::FOLDER_ENTRY;
+      if (S_ISREG(Mode))
+         return Directory::FILE_ENTRY;
+      return Directory::OTHER_ENTRY;
+   }
+
+   // classifies an entry like fs::status() does : fstatat is only called for symbolic links (their
+   // target's type is reported) and when the file system doesn't fill d_type (DT_UNKNOWN)
+   // bRealFolder is only set for folders which are not symbolic links (the ones we descend into)
+   // fstatat timed and counted in the stats : a missing entry (dangling link, entry removed during the
+   // walk) isn't an error
+   int StatAt(int iDirFd, const char* pszName, struct stat& Stat, int iFlags, Directory::WalkStats* pStats)
+   {
+      ScopedTimer Timer(StatTime(pStats));
+      const int iResult = fstatat(iDirFd, pszName, &Stat, iFlags);
+      if (iResult != 0 && errno != ENOENT)
+         AddError(pStats);
+      return iResult;
+   }
+
+   Directory::EntryType GetEntryType(int iDirFd, const char* pszName, unsigned char ucType, bool& bRealFolder,
+      Directory::WalkStats* pStats = nullptr)
+   {
+      struct stat Stat;
+      switch (ucType)
+      {
+         case DT_DIR:
+            bRealFolder = true;
+            return Directory::FOLDER_ENTRY;
+         case DT_REG:
+            return Directory::FILE_ENTRY;
+         case DT_LNK:
+            break;
+         case DT_UNKNOWN:
+            if (StatAt(iDirFd, pszName, Stat, AT_SYMLINK_NOFOLLOW, pStats) != 0)
+               return Directory::OTHER_ENTRY;
+            if (!S_ISLNK(Stat.st_mode))
+            {
+               bRealFolder = S_ISDIR(Stat.st_mode);
+               return GetEntryType(Stat.st_mode);
+            }
+            break;
+         default:
+            return Directory::OTHER_ENTRY;
+      }
+
+      if (StatAt(iDirFd, pszName, Stat, 0, pStats) != 0)
+         return Directory::OTHER_ENTRY;
+      return GetEntryType(Stat.st_mode);
+   }
+
+   void SetMetadata(Directory::EntryMetadata& Metadata, const struct stat& Stat)
+   {
+      Metadata.uSize = Stat.st_size;
+      Metadata.tModificationTime = Stat.st_mtime;
+      Metadata.uMode = Stat.st_mode;
+      Metadata.uInode = Stat.st_ino;
+   }
+
+   // classifies an entry like GetEntryType but with a single statx (following symbolic links) that
+   // also fills the metadata : the stat needed by the metadata gives the type of the links too
+   Directory::EntryType GetEntryMetadata(int iDirFd, const char* pszName, unsigned char ucType, bool& bRealFolder,
+      Directory::EntryMetadata& Metadata, Directory::WalkStats* pStats = nullptr)
+   {
+      Metadata = Directory::EntryMetadata();
+      bRealFolder = (ucType == DT_DIR);
+      if (ucType == DT_UNKNOWN)
+      {
+         struct stat Stat;
+         if (StatAt(iDirFd, pszName, Stat, AT_SYMLINK_NOFOLLOW, pStats) != 0)
+            return Directory::OTHER_ENTRY;
+         bRealFolder = S_ISDIR(Stat.st_mode);
+      }
+
+      #if defined(SYS_statx) && defined(STATX_BASIC_STATS)
+      struct statx Statx;
+      long lResult;
+      {
+         ScopedTimer Timer(StatTime(pStats));
+         lResult = syscall(SYS_statx, iDirFd, pszName, AT_NO_AUTOMOUNT,
+                           STATX_TYPE | STATX_MODE | STATX_INO | STATX_SIZE | STATX_MTIME, &Statx);
+      }
+      if (lResult == 0)
+      {
+         Metadata.uSize = Statx.stx_size;
+         Metadata.tModificationTime = Statx.stx_mtime.tv_sec;
+         Metadata.uMode = Statx.stx_mode;
+         Metadata.uInode = Statx.stx_ino;
+         return GetEntryType(Statx.stx_mode);
+      }
+      if (errno != ENOSYS) // kernels older than 4.11 don't have statx
+      {
+         if (errno != ENOENT)
+            AddError(pStats);
+         bRealFolder = false;
+         return Directory::OTHER_ENTRY;
+      }
+      #endif
+
+      struct stat Stat;
+      if (StatAt(iDirFd, pszName, Stat, 0, pStats) != 0)
+      {
+         bRealFolder = false;
+         return Directory::OTHER_ENTRY;
+      }
+      SetMetadata(Metadata, Stat);
+      return GetEntryType(Stat.st_mode);
+   }
+
+   // applies the filter to an entry of the folder iDirFd (folders are only filtered by name)
+   // the size and time are taken from pMetadata if it was already collected
+   bool IsAccepted(const Directory::WalkFilter& Filter, int iDirFd, const char* pszName, Directory::EntryType eType,
+      const Directory::EntryMetadata* pMetadata, Directory::WalkStats* pStats = nullptr)
+   {
+      if (eType == Directory::FOLDER_ENTRY)
+         return !Filter.IsFolderExcluded(pszName);
+
+      if (!Filter.IsFileNameAccepted(pszName))
+         return false;
+      if (!Filter.NeedsStat())
+         return true;
+      if (eType != Directory::FILE_ENTRY)
+         return false; // no size or write time to compare
+      if (pMetadata)
+         return Filter.IsFileStatAccepted(pMetadata->uSize, pMetadata->tModificationTime);
+
+      struct stat Stat;
+      if (StatAt(iDirFd, pszName, Stat, 0, pStats) != 0)
+         return false;
+      return Filter.IsFileStatAccepted(Stat.st_size, Stat.st_mtime);
+   }
+
+   /**
+    * @brief lists a folder with getdents64 and classifies its entries with the d_type
+    * filled by the kernel
+    *
+    * Sub-folders are opened relatively to their parent's descriptor and visited right
+    * after their own entry (same order as fs::recursive_directory_iterator), symbolic links
+    * to folders are reported but never followed. Filtered out folders are not opened.
+    */
+   class DentsWalker
+   {
+   public:
+      DentsWalker(bool bRecursive, bool bMetadata, const Directory::WalkFilter& Filter,
+         Directory::WalkStats* pStats = nullptr) :
+         m_bRecursive(bRecursive), m_bMetadata(bMetadata), m_Filter(Filter), m_pStats(pStats) {}
+
+      // bool OnEntry(const std::string& strAbsolutePath, Directory::EntryType eType,
+      //              const Directory::EntryMetadata* pMetadata, int iFolderFd), returns false to stop
+      template <typename Callback>
+      bool Walk(int iDirFd, const std::string& strRoot, Callback&& OnEntry)
+      {
+         std::string strPath(strRoot);
+         return WalkFolder(iDirFd, strPath, 0, OnEntry);
+      }
+
+   private:
+      template <typename Callback>
+      bool WalkFolder(int iDirFd, std::string& strPath, size_t uDepth, Callback& OnEntry)
+      {
+         // one buffer per depth as the parent's buffer is still being read when we descend
+         if (m_vecBuffers.size() <= uDepth)
+            m_vecBuffers.emplace_back(new char[DENTS_BUFFER_SIZE]);
+
+         const size_t uPathLength = strPath.length();
+         const bool bAppendSep = (uPathLength == 0 || strPath[uPathLength - 1] != '/');
+
+         return ReadFolder(iDirFd, m_vecBuffers[uDepth].get(), [&](const char* pszName, unsigned char ucType)
+         {
+            bool bRealFolder = false;
+            Directory::EntryMetadata Metadata;
+            const Directory::EntryMetadata* pMetadata = (m_bMetadata) ? &Metadata : nullptr;
+            Directory::EntryType eType = (m_bMetadata)
+               ? GetEntryMetadata(iDirFd, pszName, ucType, bRealFolder, Metadata, m_pStats)
+               : GetEntryType(iDirFd, pszName, ucType, bRealFolder, m_pStats);
+            if (!IsAccepted(m_Filter, iDirFd, pszName, eType, pMetadata, m_pStats))
+               return true;
+
+            if (bAppendSep)
+               strPath += '/';
+            strPath += pszName;
+
+            bool bContinue = OnEntry(static_cast<const std::string&>(strPath), eType, pMetadata, iDirFd);
+
+            if (bContinue && m_bRecursive && bRealFolder && m_Filter.CanDescend(uDepth + 1))
+            {
+               int iSubDirFd = openat(iDirFd, pszName, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+               if (iSubDirFd >= 0)
+               {
+                  bContinue = WalkFolder(iSubDirFd, strPath, uDepth + 1, OnEntry);
+                  close(iSubDirFd);
+               }
+               else
+                  AddError(m_pStats);
+            }
+            strPath.resize(uPathLength);
+            return bContinue;
+         }, m_pStats);
+      }
+
+      const bool m_bRecursive;
+      const bool m_bMetadata;
+      const Directory::WalkFilter& m_Filter;
+      Directory::WalkStats* m_pStats;
+      std::vector<std::unique_ptr<char[]>> m_vecBuffers;
+   };
+
+   /**
+    * @brief one task deque per worker : a worker pushes and pops its own tasks at the back
+    * (depth first, the folders it just read are still hot) and steals the other workers'
+    * tasks from the front (the oldest ones, usually the biggest subtrees)
+    */
+   template <typename Task>
+   class WorkStealingQueues
+   {
+   public:
+      explicit WorkStealingQueues(size_t uWorkers) : m_vecQueues(uWorkers), m_uPending(0) {}
+
+      void Push(size_t uWorker, Task Item)
+      {
+         ++m_uPending;
+         WorkerQueue& Queue = m_vecQueues[uWorker];
+         std::lock_guard<std::mutex> Lock(Queue.Mutex);
+         Queue.Tasks.push_back(std::move(Item));
+      }
+
+      // returns false once all the pushed tasks are done (no more work will ever come)
+      bool Pop(size_t uWorker, Task& Item)
+      {
+         for (unsigned uAttempts = 0; ; ++uAttempts)
+         {
+            for (size_t i = 0; i < m_vecQueues.size(); ++i)
+            {
+               const size_t uVictim = (uWorker + i) % m_vecQueues.size();
+               WorkerQueue& Queue = m_vecQueues[uVictim];
+               std::lock_guard<std::mutex> Lock(Queue.Mutex);
+               if (Queue.Tasks.empty())
+                  continue;
+
+               if (uVictim == uWorker)
+               {
+                  Item = std::move(Queue.Tasks.back());
+                  Queue.Tasks.pop_back();
+               }
+               else
+               {
+                  Item = std::move(Queue.Tasks.front());
+                  Queue.Tasks.pop_front();
+               }
+               return true;
+            }
+
+            // other workers are still busy and may push new tasks
+            if (m_uPending.load() == 0)
+               return false;
+
+            if (uAttempts < 64)
+               std::this_thread::yield();
+            else
+               std::this_thread::sleep_for(std::chrono::microseconds(50));
+         }
+      }
+
+      // to be called when a popped task is finished (after it pushed its own sub-tasks)
+      void Done() { --m_uPending; }
+
+   private:
+      struct WorkerQueue
+      {
+         std::mutex Mutex;
+         std::deque<Task> Tasks;
+      };
+
+      std::vector<WorkerQueue> m_vecQueues;
+      std::atomic<size_t> m_uPending;
+   };
+
+   /**
+    * @brief recursive listing where a pool of workers reads the folders in parallel
+    *
+    * Each folder's entries are kept in getdents order and the entries are reported
+    * once all the folders are read, by a depth first traversal of the results : the
+    * output is exactly the serial DentsWalker's one, whatever the count of threads.
+    */
+   class ParallelDentsWalker
+   {
+   public:
+      ParallelDentsWalker(size_t uThreads, bool bMetadata, const Directory::WalkFilter& Filter,
+         Directory::WalkStats* pStats = nullptr) :
+         m_uThreads(uThreads), m_bMetadata(bMetadata), m_Filter(Filter), m_pStats(pStats) {}
+
+      // bool OnEntry(const std::string& strAbsolutePath, Directory::EntryType eType,
+      //              const Directory::EntryMetadata* pMetadata, int iFolderFd), returns false to stop
+      // (the entries are reported once the folders are closed : iFolderFd is -1)
+      template <typename Callback>
+      bool Walk(int iDirFd, const std::string& strRoot, Callback&& OnEntry)
+      {
+         Folder Root;
+         Root.strPath = strRoot;
+
+         WorkStealingQueues<Folder*> Queues(m_uThreads);
+         Queues.Push(0, &Root);
+
+         std::mutex StatsMutex;
+         RunWorkers(m_uThreads, [&](size_t uWorker)
+         {
+            // each worker has its own counters, added to the walk's ones at the end
+            Directory::WalkStats WorkerStats;
+            Directory::WalkStats* pStats = (m_pStats) ? &WorkerStats : nullptr;
+            std::unique_ptr<char[]> pBuffer(new char[DENTS_BUFFER_SIZE]);
+            Folder* pFolder = nullptr;
+            while (Queues.Pop(uWorker, pFolder))
+            {
+               int iFd = (pFolder == &Root) ? iDirFd : OpenSubFolder(*pFolder->pParent, GetLastName(pFolder->strPath));
+               pFolder->pParent.reset();
+               if (iFd < 0)
+                  AddError(pStats);
+               else
+               {
+                  ReadFolder(iFd, pBuffer.get(), [&](const char* pszName, unsigned char ucType)
+                  {
+                     bool bRealFolder = false;
+                     Directory::EntryMetadata Metadata;
+                     const Directory::EntryType eType = (m_bMetadata)
+                        ? GetEntryMetadata(iFd, pszName, ucType, bRealFolder, Metadata, pStats)
+                        : GetEntryType(iFd, pszName, ucType, bRealFolder, pStats);
+                     if (!IsAccepted(m_Filter, iFd, pszName, eType, (m_bMetadata) ? &Metadata : nullptr, pStats))
+                        return true;
+
+                     pFolder->vecEntries.push_back(Entry());
+                     Entry& NewEntry = pFolder->vecEntries.back();
+                     NewEntry.eType = eType;
+                     NewEntry.Metadata = Metadata;
+                     NewEntry.uNameOffset = pFolder->strNames.size();
+                     pFolder->strNames.append(pszName).push_back('\0');
+                     if (bRealFolder && m_Filter.CanDescend(pFolder->uDepth + 1))
+                     {
+                        NewEntry.pFolder.reset(new Folder);
+                        JoinPath(pFolder->strPath, pszName, NewEntry.pFolder->strPath);
+                        NewEntry.pFolder->uDepth = pFolder->uDepth + 1;
+                     }
+                     return true;
+                  }, pStats);
+
+                  // the sub-folders are opened relatively to this one, closed once they all are
+                  const FolderHandlePtr pHandle = std::make_shared<FolderHandle>(iFd, iFd != iDirFd);
+                  for (Entry& SubEntry : pFolder->vecEntries)
+                     if (SubEntry.pFolder)
+                     {
+                        SubEntry.pFolder->pParent = pHandle;
+                        Queues.Push(uWorker, SubEntry.pFolder.get());
+                     }
+               }
+               Queues.Done();
+            }
+
+            if (m_pStats)
+            {
+               std::lock_guard<std::mutex> Lock(StatsMutex);
+               *m_pStats += WorkerStats;
+            }
+         });
+
+         std::string strPath;
+         return Report(Root, strPath, OnEntry);
+      }
+
+   private:
+      struct Folder;
+
+      struct Entry
+      {
+         size_t uNameOffset; // in the folder's names
+         Directory::EntryType eType;
+         Directory::EntryMetadata Metadata; // only filled if collected
+         std::unique_ptr<Folder> pFolder;   // only for the folders to descend into
+      };
+
+      struct Folder
+      {
+         std::string strPath;
+         FolderHandlePtr pParent; // until the folder is opened
+         size_t uDepth = 0; // the root's entries are at depth 1
+         std::vector<Entry> vecEntries;
+         std::string strNames; // '\0' terminated names of the entries : no allocation per entry
+      };
+
+      static void JoinPath(const std::string& strFolder, const char* pszName, std::string& strPath)
+      {
+         strPath.assign(strFolder);
+         if (strFolder.empty() || strFolder[strFolder.length() - 1] != '/')
+            strPath.push_back('/');
+         strPath.append(pszName);
+      }
+
+      // strPath : buffer reused by all the entries
+      template <typename Callback>
+      bool Report(Folder& CurrentFolder, std::string& strPath, Callback& OnEntry) const
+      {
+         for (Entry& CurrentEntry : CurrentFolder.vecEntries)
+         {
+            if (CurrentEntry.pFolder)
+               strPath.assign(CurrentEntry.pFolder->strPath);
+            else
+               JoinPath(CurrentFolder.strPath, CurrentFolder.strNames.c_str() + CurrentEntry.uNameOffset, strPath);
+            if (!OnEntry(strPath, CurrentEntry.eType, (m_bMetadata) ? &CurrentEntry.Metadata : nullptr, -1))
+               return false;
+
+            if (CurrentEntry.pFolder)
+            {
+               if (!Report(*CurrentEntry.pFolder, strPath, OnEntry))
+                  return false;
+               CurrentEntry.pFolder.reset(); // release the subtree as soon as it is reported
+            }
+         }
+         return true;
+      }
+
+      const size_t m_uThreads;
+      const bool m_bMetadata;
+      const Directory::WalkFilter& m_Filter;
+      Directory::WalkStats* m_pStats;
+   };
+}
+#endif
+
 // ZIP
 
 const bool Zip::ExtractAllFilesFromZip(const std::string& strDirectory, const std::string& strZipFile,
@@ -218,6 +835,187 @@ const long Zip::RemoveEntryFromZip(const std::string& strZipFile, const std::str
    return uDelCount;
 }
 
+/* 64-bit hash of a string, 8 bytes at a time */
+uint64_t FlatHashMap::Hash(const char* pszData, const size_t uLength)
+{
+   const uint64_t uMultiplier = 0x9E3779B97F4A7C15ULL;
+   uint64_t uHash = 0xCBF29CE484222325ULL ^ (uLength * uMultiplier);
+   size_t uOffset = 0;
+   for (; uOffset + 8 <= uLength; uOffset += 8)
+   {
+      uint64_t uWord;
+      std::memcpy(&uWord, pszData + uOffset, 8);
+      uHash = (uHash ^ uWord) * uMultiplier;
+      uHash ^= uHash >> 29;
+   }
+   if (uOffset < uLength)
+   {
+      uint64_t uWord = 0;
+      std::memcpy(&uWord, pszData + uOffset, uLength - uOffset);
+      uHash = (uHash ^ uWord) * uMultiplier;
+   }
+   uHash ^= uHash >> 32;
+   uHash *= 0xD6E8FEB86659FD93ULL;
+   return uHash ^ (uHash >> 32);
+}
+
+void FlatHashMap::reserve(const size_t uEntries, const size_t uPoolSize)
+{
+   m_vecEntries.reserve(uEntries);
+   m_strPool.reserve(uPoolSize);
+
+   // load factor at most 3/4
+   size_t uSlotsCount = 16;
+   while (uSlotsCount * 3 < uEntries * 4)
+      uSlotsCount *= 2;
+   if (uSlotsCount > m_vecSlots.size())
+      Rehash(uSlotsCount);
+}
+
+void FlatHashMap::clear()
+{
+   m_strPool.clear();
+   m_vecEntries.clear();
+   std::fill(m_vecSlots.begin(), m_vecSlots.end(), Slot{ 0, 0 });
+}
+
+/* index of the slot holding the key or of the empty slot where it would be inserted */
+size_t FlatHashMap::FindSlot(const char* pszKey, const size_t uKeyLength, const uint64_t uHash) const
+{
+   size_t uSlot = static_cast<size_t>(uHash) & m_uSlotsMask;
+   while (m_vecSlots[uSlot].uKeyOffset != 0)
+   {
+      const Slot& Current = m_vecSlots[uSlot];
+      if (Current.uHash == uHash && Current.uKeyOffset + uKeyLength < m_strPool.size()
+         && m_strPool[Current.uKeyOffset + uKeyLength] == '\0'
+         && std::memcmp(m_strPool.data() + Current.uKeyOffset, pszKey, uKeyLength) == 0)
+         break;
+      uSlot = (uSlot + 1) & m_uSlotsMask;
+   }
+   return uSlot;
+}
+
+// the stored hashes are used, the keys aren't read
+void FlatHashMap::Rehash(const size_t uSlotsCount)
+{
+   std::vector<Slot> vecSlots(uSlotsCount, Slot{ 0, 0 });
+   const size_t uMask = uSlotsCount - 1;
+   for (const Slot& Current : m_vecSlots)
+   {
+      if (Current.uKeyOffset == 0)
+         continue;
+      size_t uSlot = static_cast<size_t>(Current.uHash) & uMask;
+      while (vecSlots[uSlot].uKeyOffset != 0)
+         uSlot = (uSlot + 1) & uMask;
+      vecSlots[uSlot] = Current;
+   }
+   m_vecSlots.swap(vecSlots);
+   m_uSlotsMask = uMask;
+}
+
+std::pair<FlatHashMap::const_iterator, bool> FlatHashMap::insert(const char* pszKey, const size_t uKeyLength,
+   const char* pszValue, const size_t uValueLength)
+{
+   if ((m_vecEntries.size() + 1) * 4 > m_vecSlots.size() * 3)
+      Rehash(m_vecSlots.empty() ? 16 : m_vecSlots.size() * 2);
+
+   const uint64_t uHash = Hash(pszKey, uKeyLength);
+   const size_t uSlot = FindSlot(pszKey, uKeyLength, uHash);
+   if (m_vecSlots[uSlot].uKeyOffset != 0)
+      return std::make_pair(const_iterator(this, GetEntryIndex(m_vecSlots[uSlot].uKeyOffset)), false);
+
+   // full width offsets, lengths and index : no limit on the pool's size nor on the count of entries
+   const size_t uEntry = m_vecEntries.size();
+   m_strPool.append(reinterpret_cast<const char*>(&uEntry), sizeof(uEntry));
+   m_vecEntries.push_back(Entry{ m_strPool.size(), uKeyLength, uValueLength });
+   m_strPool.append(pszKey, uKeyLength).push_back('\0');
+   m_strPool.append(pszValue, uValueLength).push_back('\0');
+   m_vecSlots[uSlot] = Slot{ uHash, m_vecEntries.back().uKeyOffset };
+   return std::make_pair(const_iterator(this, m_vecEntries.size() - 1), true);
+}
+
+FlatHashMap::const_iterator FlatHashMap::find(const char* pszKey, const size_t uKeyLength) const
+{
+   if (m_vecEntries.empty())
+      return end();
+   const size_t uSlot = FindSlot(pszKey, uKeyLength, Hash(pszKey, uKeyLength));
+   return (m_vecSlots[uSlot].uKeyOffset != 0) ? const_iterator(this, GetEntryIndex(m_vecSlots[uSlot].uKeyOffset)) : end();
+}
+
+bool FlatHashMap::operator==(const FlatHashMap& Other) const
+{
+   if (size() != Other.size())
+      return false;
+   for (size_t uIndex = 0; uIndex < m_vecEntries.size(); ++uIndex)
+   {
+      const value_type Pair = GetPair(uIndex);
+      const_iterator it = Other.find(Pair.first.data(), Pair.first.size());
+      if (it == Other.end() || it->second != Pair.second)
+         return false;
+   }
+   return true;
+}
+
+PooledString FlatHashMap::at(const PooledString& Key) const
+{
+   const_iterator it = find(Key);
+   if (it == end())
+      throw std::out_of_range("FlatHashMap::at");
+   return it->second;
+}
+
+PooledString StringArena::Store(const char* pszData, const size_t uLength)
+{
+   while (m_uBlock < m_vecBlocks.size() && m_uOffset + uLength + 1 > m_vecBlocks[m_uBlock].uSize)
+   {
+      ++m_uBlock;
+      m_uOffset = 0;
+   }
+   if (m_uBlock == m_vecBlocks.size())
+   {
+      // geometric growth : few blocks until the next Reset merges them
+      const size_t uSize = std::max(std::max(m_uBlockSize, GetCapacity()), uLength + 1);
+      m_vecBlocks.push_back(Block{ std::unique_ptr<char[]>(new char[uSize]), uSize });
+   }
+
+   char* pszStored = m_vecBlocks[m_uBlock].pData.get() + m_uOffset;
+   std::memcpy(pszStored, pszData, uLength);
+   pszStored[uLength] = '\0';
+   m_uOffset += uLength + 1;
+   m_uUsedSize += uLength + 1;
+   return PooledString(pszStored, uLength);
+}
+
+// the strings stored until now must no longer be used
+void StringArena::Reset()
+{
+   if (m_vecBlocks.size() > 1)
+   {
+      const size_t uCapacity = GetCapacity();
+      m_vecBlocks.clear();
+      m_vecBlocks.push_back(Block{ std::unique_ptr<char[]>(new char[uCapacity]), uCapacity });
+   }
+   m_uBlock = 0;
+   m_uOffset = 0;
+   m_uUsedSize = 0;
+}
+
+void StringArena::Release()
+{
+   m_vecBlocks.clear();
+   m_uBlock = 0;
+   m_uOffset = 0;
+   m_uUsedSize = 0;
+}
+
+const size_t StringArena::GetCapacity() const
+{
+   size_t uCapacity = 0;
+   for (const Block& Current : m_vecBlocks)
+      uCapacity += Current.uSize;
+   return uCapacity;
+}
+
 /**
  * @brief creates a folder
  *
@@ -365,21 +1163,665 @@ const bool Directory::EraseFile(const std::string& strFilePath)
 // Effects:  Recursively deletes the contents of p if it exists, then deletes file p itself, as if by POSIX
 // Postcondition: !exists(p)
 // Returns: The number of files removed.
-const size_t Directory::EraseFolder(const std::string& strFolderPath, bool& bSuccess)
+#ifdef LINUX
+namespace
 {
-   uintmax_t uDeletedItems = 0;
-   bSuccess = true;
-   try
+   const int IOPRIO_WHO_THREAD = 1;         // IOPRIO_WHO_PROCESS, with 0 : the calling thread
+   const int IOPRIO_IDLE = 3 << 13;         // IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 0)
+
+   // the calling thread uses the idle I/O priority class in its scope, if IoThrottle asks for it
+   class ScopedIdlePriority
    {
-      uDeletedItems = fs::remove_all(strFolderPath);
-   }
-   catch (const fs::filesystem_error& ex)
+   public:
+      ScopedIdlePriority() : m_iPrevious(-1)
+      {
+         if (!IoThrottle::GetInstance().IsIdlePriority())
+            return;
+         m_iPrevious = static_cast<int>(syscall(SYS_ioprio_get, IOPRIO_WHO_THREAD, 0));
+         if (m_iPrevious >= 0 && syscall(SYS_ioprio_set, IOPRIO_WHO_THREAD, 0, IOPRIO_IDLE) != 0)
+            m_iPrevious = -1;
+      }
+
+      ~ScopedIdlePriority()
+      {
+         if (m_iPrevious >= 0)
+            syscall(SYS_ioprio_set, IOPRIO_WHO_THREAD, 0, m_iPrevious);
+      }
+
+   private:
+      int m_iPrevious; // priority to restore
+   };
+
+   // takes the IoThrottle's tokens of the removal of an entry of the folder iDirFd : its size is only
+   // read if a bytes rate is set and if it isn't known
+   void ThrottleRemoval(int iDirFd, const char* pszName, uint64_t uSize = UINT64_MAX)
    {
-      bSuccess = false;
-      std::cout << ex.what() << std::endl;
+      IoThrottle& Throttle = IoThrottle::GetInstance();
+      if (!Throttle.IsLimited())
+         return;
+      struct stat Stat;
+      if (uSize == UINT64_MAX)
+         uSize = (Throttle.LimitsBytes() && fstatat(iDirFd, pszName, &Stat, AT_SYMLINK_NOFOLLOW) == 0
+            && S_ISREG(Stat.st_mode)) ? static_cast<uint64_t>(Stat.st_size) : 0;
+      Throttle.Acquire(1, uSize);
    }
-   return uDeletedItems;
-}
+
+   // removes the content of the folder iDirFd, relatively to its descriptor (symbolic links aren't
+   // followed), stops at the first failure : uRemoved counts the entries removed until then
+   bool RemoveFolderContent(int iDirFd, std::string& strPath, char* pBuffer, size_t& uRemoved)
+   {
+      // the folder is read before removing anything : a folder modified while being read may skip entries
+      std::vector<std::pair<std::string, unsigned char>> vecEntries;
+      ReadFolder(iDirFd, pBuffer, [&vecEntries](const char* pszName, unsigned char ucType)
+      {
+         vecEntries.emplace_back(pszName, ucType);
+         return true;
+      });
+
+      const size_t uPathLength = strPath.length();
+      for (const auto& Entry : vecEntries)
+      {
+         const char* pszName = Entry.first.c_str();
+         bool bFolder = (Entry.second == DT_DIR);
+         struct stat Stat;
+         if (Entry.second == DT_UNKNOWN && fstatat(iDirFd, pszName, &Stat, AT_SYMLINK_NOFOLLOW) == 0)
+            bFolder = S_ISDIR(Stat.st_mode);
+
+         // on failure, strPath is left to the entry that couldn't be removed
+         strPath += '/';
+         strPath += Entry.first;
+         if (bFolder)
+         {
+            int iSubDirFd = openat(iDirFd, pszName, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+            if (iSubDirFd < 0)
+               return false;
+            const bool bRemoved = RemoveFolderContent(iSubDirFd, strPath, pBuffer, uRemoved);
+            close(iSubDirFd);
+            if (!bRemoved)
+               return false;
+         }
+
+         ThrottleRemoval(iDirFd, pszName, (bFolder) ? 0 : UINT64_MAX);
+         if (unlinkat(iDirFd, pszName, (bFolder) ? AT_REMOVEDIR : 0) != 0)
+            return false;
+         strPath.resize(uPathLength);
+         ++uRemoved;
+      }
+      return true;
+   }
+
+   /**
+    * @brief removes a folder and its content with a pool of threads : each task empties one folder
+    * (its files are unlinked relatively to its descriptor, its sub-folders become new tasks) and a
+    * folder is removed by the task which finishes its last sub-folder, so that the folders are
+    * removed bottom-up. Below the root, the folders are opened and removed relatively to their parent's
+    * descriptor (no path is resolved again, so a folder replaced by a symlink isn't followed).
+    * After a failure (or once *pStop is set), the workers stop removing entries.
+    */
+   class ParallelRemover
+   {
+   public:
+      explicit ParallelRemover(size_t uThreads, const std::atomic<bool>* pStop = nullptr) :
+         m_uThreads(uThreads), m_pStop(pStop), m_uRemoved(0), m_bFailed(false), m_iError(0) {}
+
+      // returns false if an entry couldn't be removed (GetFailedPath() and errno tell which one and why)
+      // or if the removal was stopped
+      bool Remove(const std::string& strFolderPath)
+      {
+         std::vector<std::vector<std::unique_ptr<Folder>>> vecFolders(m_uThreads); // owned by the worker which found them
+         vecFolders[0].emplace_back(new Folder(nullptr, nullptr, strFolderPath));
+
+         WorkStealingQueues<Folder*> Queues(m_uThreads);
+         Queues.Push(0, vecFolders[0].back().get());
+         RunWorkers(m_uThreads, [&](size_t uWorker)
+         {
+            ScopedIdlePriority Priority;
+            std::unique_ptr<char[]> pBuffer(new char[DENTS_BUFFER_SIZE]);
+            std::vector<std::string> vecSubFolders;
+            Folder* pFolder = nullptr;
+            while (Queues.Pop(uWorker, pFolder))
+            {
+               if (!IsStopping())
+               {
+                  vecSubFolders.clear();
+                  FolderHandlePtr pHandle;
+                  if (EmptyFolder(*pFolder, pBuffer.get(), vecSubFolders, pHandle))
+                  {
+                     // pending until the sub-folders are removed, this task counts for one
+                     pFolder->uPending.store(vecSubFolders.size() + 1);
+                     for (std::string& strName : vecSubFolders)
+                     {
+                        vecFolders[uWorker].emplace_back(new Folder(pFolder, pHandle, pFolder->strPath + '/' + strName));
+                        Queues.Push(uWorker, vecFolders[uWorker].back().get());
+                     }
+                     Finish(pFolder);
+                  }
+               }
+               Queues.Done();
+            }
+         });
+
+         if (m_bFailed.load())
+            errno = m_iError;
+         return !IsStopping();
+      }
+
+      inline size_t GetRemovedCount() const { return m_uRemoved.load(); }
+      inline const std::string& GetFailedPath() const { return m_strFailedPath; }
+
+   private:
+      struct Folder
+      {
+         Folder(Folder* pParentFolder, FolderHandlePtr pParentFolderHandle, std::string strFolderPath) :
+            pParent(pParentFolder), pParentHandle(std::move(pParentFolderHandle)),
+            strPath(std::move(strFolderPath)), uPending(0) {}
+
+         Folder* pParent;
+         FolderHandlePtr pParentHandle; // kept until the folder is removed, null for the root
+         std::string strPath;
+         std::atomic<size_t> uPending; // sub-folders not removed yet (+ 1 while the folder is emptied)
+      };
+
+      // unlinks the entries of the folder which aren't folders and returns the names of its sub-folders
+      // (and, if it has some, the handle they are opened and removed with)
+      bool EmptyFolder(const Folder& Dir, char* pBuffer, std::vector<std::string>& vecSubFolders,
+                       FolderHandlePtr& pHandle)
+      {
+         int iDirFd = (Dir.pParentHandle) ? OpenSubFolder(*Dir.pParentHandle, GetLastName(Dir.strPath))
+                                          : open(Dir.strPath.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+         if (iDirFd < 0)
+            return Fail(Dir.strPath);
+
+         // the folder is read before removing anything : a folder modified while being read may skip entries
+         std::vector<std::string> vecFiles;
+         ReadFolder(iDirFd, pBuffer, [&](const char* pszName, unsigned char ucType)
+         {
+            bool bFolder = (ucType == DT_DIR);
+            struct stat Stat;
+            if (ucType == DT_UNKNOWN && fstatat(iDirFd, pszName, &Stat, AT_SYMLINK_NOFOLLOW) == 0)
+               bFolder = S_ISDIR(Stat.st_mode);
+            ((bFolder) ? vecSubFolders : vecFiles).emplace_back(pszName);
+            return true;
+         });
+
+         bool bSuccess = true;
+         for (const std::string& strName : vecFiles)
+         {
+            if (!IsStopping())
+               ThrottleRemoval(iDirFd, strName.c_str());
+            if (IsStopping() || unlinkat(iDirFd, strName.c_str(), 0) != 0)
+            {
+               if (!IsStopping())
+                  Fail(Dir.strPath + '/' + strName);
+               bSuccess = false;
+               break;
+            }
+            ++m_uRemoved;
+         }
+         if (bSuccess && !vecSubFolders.empty())
+            pHandle = std::make_shared<FolderHandle>(iDirFd, true);
+         else
+            close(iDirFd);
+         return bSuccess;
+      }
+
+      // the task of the folder or of one of its sub-folders is done : the folders whose last pending task
+      // it was are removed, up to the first one still waiting for other sub-folders
+      void Finish(Folder* pFolder)
+      {
+         for (; pFolder && --pFolder->uPending == 0; pFolder = pFolder->pParent)
+         {
+            if (!IsStopping())
+               IoThrottle::GetInstance().Acquire(1, 0);
+            if (IsStopping() || RemoveFolder(*pFolder) != 0)
+            {
+               if (!IsStopping())
+                  Fail(pFolder->strPath);
+               return;
+            }
+            ++m_uRemoved;
+         }
+      }
+
+      // the parent's descriptor is released once its sub-folder is removed
+      int RemoveFolder(Folder& Dir)
+      {
+         if (!Dir.pParentHandle)
+            return rmdir(Dir.strPath.c_str());
+
+         const int iResult = unlinkat(Dir.pParentHandle->Get(), GetLastName(Dir.strPath), AT_REMOVEDIR);
+         const int iError = errno;
+         Dir.pParentHandle.reset();
+         errno = iError;
+         return iResult;
+      }
+
+      inline bool IsStopping() const { return m_bFailed.load() || (m_pStop && m_pStop->load()); }
+
+      // keeps the first failure
+      bool Fail(const std::string& strPath)
+      {
+         const int iError = errno;
+         std::lock_guard<std::mutex> Lock(m_Mutex);
+         if (!m_bFailed.load())
+         {
+            m_strFailedPath = strPath;
+            m_iError = iError;
+            m_bFailed.store(true);
+         }
+         return false;
+      }
+
+      const size_t m_uThreads;
+      const std::atomic<bool>* m_pStop;
+      std::atomic<size_t> m_uRemoved;
+      std::atomic<bool> m_bFailed;
+      std::mutex m_Mutex;
+      std::string m_strFailedPath;
+      int m_iError;
+   };
+
+   /**
+    * @brief deletes the files of a directory according to a retention policy with a pool of threads :
+    * each task reads one folder and stats its entries relatively to its descriptor, then unlinks the
+    * folder's expired files together, its sub-folders become new tasks (a worker keeps the subtrees it
+    * finds unless other workers steal them). Like the listing, symbolic links to files are deleted if
+    * their target expired and symbolic links to folders aren't followed : below the root, a folder is
+    * opened relatively to its parent's descriptor (O_NOFOLLOW), never by its path.
+    *
+    * The criteria are applied in order : age, newest files of each folder (partial sort of the
+    * folder's files), size quota. The quota is applied once the walk is over, to all the kept files
+    * (so that the victims don't depend on the order of the walk) : a heap of them, oldest on top, gives
+    * the oldest ones until the total size of the others fits in. Until then, the folders holding kept
+    * files or sub-folders keep their descriptor (up to half of the process' limit) : the victims are
+    * unlinked relatively to it, a folder beyond the limit is opened again from its nearest ancestor which
+    * kept one, one name at a time.
+    *
+    * When pruning, a folder is complete once its sub-folders are : if this pass deleted some of its
+    * files or sub-folders, it is removed relatively to its parent's descriptor (kept until then) if it
+    * is empty. A folder already empty is kept and the root is never removed. The folders emptied by the
+    * quota are pruned after it, with their parents left empty.
+    */
+   class ParallelCleaner
+   {
+   public:
+      struct Policy
+      {
+         std::time_t tLimit = std::numeric_limits<std::time_t>::min(); // files modified before are deleted
+         size_t uKeepPerFolder = SIZE_MAX;
+         uint64_t uMaxTotalSize = UINT64_MAX;
+      };
+
+      ParallelCleaner(size_t uThreads, bool bRecursive, const Policy& CleanUpPolicy, bool bPrune = false) :
+         m_uThreads(uThreads), m_bRecursive(bRecursive), m_bPrune(bRecursive && bPrune), m_Policy(CleanUpPolicy),
+         m_iRootFd(-1), m_uHandles(0), m_uMaxHandles(0) {}
+
+      // returns the count of deleted files
+      size_t CleanUp(const std::string& strDirectory)
+      {
+         // the root may be a symbolic link, like with the listing
+         m_iRootFd = open(strDirectory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+         if (m_iRootFd < 0)
+            return 0;
+         struct rlimit Limit;
+         m_uMaxHandles = (getrlimit(RLIMIT_NOFILE, &Limit) == 0 && Limit.rlim_cur != RLIM_INFINITY)
+            ? static_cast<size_t>(Limit.rlim_cur / 2) : 4096;
+
+         std::atomic<size_t> uDeleted(0);
+         std::vector<std::vector<std::unique_ptr<Folder>>> vecFolders(m_uThreads); // owned by the worker which found them
+         std::vector<std::vector<File>> vecKept(m_uThreads); // for the quota
+         vecFolders[0].emplace_back(new Folder(nullptr, nullptr, strDirectory));
+         vecFolders[0].back()->pHandle = std::make_shared<FolderHandle>(m_iRootFd, false);
+
+         WorkStealingQueues<Folder*> Queues(m_uThreads);
+         Queues.Push(0, vecFolders[0].back().get());
+         RunWorkers(m_uThreads, [&](size_t uWorker)
+         {
+            ScopedIdlePriority Priority;
+            std::unique_ptr<char[]> pBuffer(new char[DENTS_BUFFER_SIZE]);
+            std::vector<File> vecFiles;
+            std::vector<std::string> vecSubFolders;
+            Folder* pFolder = nullptr;
+            size_t uWorkerDeleted = 0;
+            while (Queues.Pop(uWorker, pFolder))
+            {
+               const std::string& strFolder = pFolder->strPath;
+               vecSubFolders.clear();
+
+               FolderHandlePtr pHandle;
+               const int iDirFd = (pFolder->pParent) ? OpenSubFolder(*pFolder->pParentHandle, GetLastName(strFolder))
+                                                     : m_iRootFd;
+               if (!m_bPrune)
+                  pFolder->pParentHandle.reset();
+               if (iDirFd >= 0)
+               {
+                  vecFiles.clear();
+                  ReadFolder(iDirFd, pBuffer.get(), [&](const char* pszName, unsigned char ucType)
+                  {
+                     struct stat Stat;
+                     if (IsFolder(iDirFd, pszName, ucType))
+                     {
+                        if (m_bRecursive)
+                           vecSubFolders.emplace_back(pszName);
+                     }
+                     else if ((ucType == DT_REG || ucType == DT_LNK || ucType == DT_UNKNOWN)
+                        && fstatat(iDirFd, pszName, &Stat, 0) == 0 && S_ISREG(Stat.st_mode))
+                        vecFiles.push_back({ pszName, Stat.st_mtime, static_cast<uint64_t>(Stat.st_size), pFolder });
+                     return true;
+                  });
+
+                  // the files to delete are moved to the end
+                  auto itKept = std::partition(vecFiles.begin(), vecFiles.end(),
+                     [this](const File& Candidate) { return Candidate.tModificationTime >= m_Policy.tLimit; });
+                  if (static_cast<size_t>(itKept - vecFiles.begin()) > m_Policy.uKeepPerFolder)
+                  {
+                     std::nth_element(vecFiles.begin(), vecFiles.begin() + m_Policy.uKeepPerFolder, itKept, IsNewer);
+                     itKept = vecFiles.begin() + m_Policy.uKeepPerFolder;
+                  }
+                  for (auto itFile = itKept; itFile != vecFiles.end(); ++itFile)
+                  {
+                     if (Delete(iDirFd, strFolder, *itFile))
+                     {
+                        ++uWorkerDeleted;
+                        pFolder->bChanged.store(true);
+                     }
+                  }
+                  // kept for the quota's victims of the folder or of its subtree
+                  const bool bKeepHandle = IsQuota() && pFolder->pParent
+                     && (itKept != vecFiles.begin() || !vecSubFolders.empty()) && m_uHandles++ < m_uMaxHandles;
+                  if (!vecSubFolders.empty() || bKeepHandle)
+                     pHandle = std::make_shared<FolderHandle>(iDirFd, iDirFd != m_iRootFd);
+                  else if (iDirFd != m_iRootFd)
+                     close(iDirFd);
+                  if (bKeepHandle)
+                     pFolder->pHandle = pHandle;
+
+                  if (IsQuota())
+                     vecKept[uWorker].insert(vecKept[uWorker].end(), std::make_move_iterator(vecFiles.begin()),
+                        std::make_move_iterator(itKept));
+               }
+
+               // pending until the sub-folders are cleaned up, this task counts for one
+               pFolder->uPending.store(vecSubFolders.size() + 1);
+               for (const std::string& strName : vecSubFolders)
+               {
+                  vecFolders[uWorker].emplace_back(new Folder(pFolder, pHandle,
+                     strFolder + ((strFolder.back() == '/') ? "" : "/") + strName));
+                  Queues.Push(uWorker, vecFolders[uWorker].back().get());
+               }
+               Finish(pFolder);
+               Queues.Done();
+            }
+            uDeleted += uWorkerDeleted;
+         });
+         if (IsQuota())
+            uDeleted += ApplyQuota(vecKept);
+         vecFolders.clear();
+         close(m_iRootFd);
+         return uDeleted.load();
+      }
+
+   private:
+      struct Folder
+      {
+         Folder(Folder* pParentFolder, FolderHandlePtr pParentFolderHandle, std::string strFolderPath) :
+            pParent(pParentFolder), pParentHandle(std::move(pParentFolderHandle)),
+            strPath(std::move(strFolderPath)), uPending(0), bChanged(false) {}
+
+         Folder* pParent;
+         FolderHandlePtr pParentHandle; // until the folder is opened (pruned when pruning), null for the root
+         FolderHandlePtr pHandle; // until the quota is applied, if kept
+         std::string strPath;
+         std::atomic<size_t> uPending; // sub-folders not cleaned up yet (+ 1 while the folder is cleaned up)
+         std::atomic<bool> bChanged; // files or sub-folders deleted by this pass
+      };
+
+      struct File
+      {
+         std::string strName;
+         std::time_t tModificationTime;
+         uint64_t uSize;
+         const Folder* pFolder;
+      };
+
+      // newest first, the paths break ties so that the result doesn't depend on the reading order
+      static bool IsNewer(const File& A, const File& B)
+      {
+         if (A.tModificationTime != B.tModificationTime)
+            return A.tModificationTime > B.tModificationTime;
+         if (A.pFolder != B.pFolder && A.pFolder->strPath != B.pFolder->strPath)
+            return A.pFolder->strPath > B.pFolder->strPath;
+         return A.strName > B.strName;
+      }
+
+      // a folder to read (not a symbolic link)
+      static bool IsFolder(int iDirFd, const char* pszName, unsigned char ucType)
+      {
+         struct stat Stat;
+         if (ucType != DT_UNKNOWN)
+            return ucType == DT_DIR;
+         return fstatat(iDirFd, pszName, &Stat, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(Stat.st_mode);
+      }
+
+      static bool Delete(int iDirFd, const std::string& strFolder, const File& Victim)
+      {
+         ThrottleRemoval(iDirFd, Victim.strName.c_str(), Victim.uSize);
+         if (unlinkat(iDirFd, Victim.strName.c_str(), 0) == 0)
+            return true;
+         std::cerr << "[ERROR][Directory::CleanUpFiles] File '" + strFolder + '/' + Victim.strName
+            + "' could not be deleted.\n" << std::flush;
+         return false;
+      }
+
+      inline bool IsQuota() const { return m_Policy.uMaxTotalSize != UINT64_MAX; }
+
+      // the descriptor the folder kept, or opened again from its nearest ancestor which kept one (the root
+      // always does) without following symbolic links, null if it can't be opened
+      FolderHandlePtr GetHandle(const Folder& Dir) const
+      {
+         if (Dir.pHandle)
+            return Dir.pHandle;
+
+         const FolderHandlePtr pParentHandle = GetHandle(*Dir.pParent);
+         const int iDirFd = (pParentHandle) ? OpenSubFolder(*pParentHandle, GetLastName(Dir.strPath)) : -1;
+         return (iDirFd >= 0) ? std::make_shared<FolderHandle>(iDirFd, true) : nullptr;
+      }
+
+      // the task of the folder or of one of its sub-folders is done : the folders whose last pending task
+      // it was are complete, they are pruned if this pass emptied them
+      void Finish(Folder* pFolder)
+      {
+         for (; pFolder && --pFolder->uPending == 0; pFolder = pFolder->pParent)
+         {
+            if (!pFolder->pParentHandle)
+               continue;
+            if (pFolder->bChanged.load())
+               Prune(pFolder->pParentHandle->Get(), *pFolder);
+            pFolder->pParentHandle.reset();
+         }
+      }
+
+      // removes the folder if it is empty, its parent is then changed too
+      static bool Prune(int iParentFd, const Folder& Dir)
+      {
+         const char* pszName = GetLastName(Dir.strPath);
+         ThrottleRemoval(iParentFd, pszName, 0);
+         if (unlinkat(iParentFd, pszName, AT_REMOVEDIR) == 0)
+         {
+            Dir.pParent->bChanged.store(true);
+            return true;
+         }
+         if (errno != ENOTEMPTY && errno != EEXIST)
+            std::cerr << "[ERROR][Directory::CleanUpFiles] Folder '" + Dir.strPath + "' could not be removed.\n"
+               << std::flush;
+         return false;
+      }
+
+      // deletes the oldest of the kept files (gathered by each worker) until the others fit in the quota,
+      // returns the count of deleted files
+      size_t ApplyQuota(std::vector<std::vector<File>>& vecKept) const
+      {
+         std::vector<File> vecFiles;
+         uint64_t uTotalSize = 0;
+         for (std::vector<File>& vecWorkerKept : vecKept)
+         {
+            for (File& Kept : vecWorkerKept)
+            {
+               uTotalSize += Kept.uSize;
+               vecFiles.push_back(std::move(Kept));
+            }
+            std::vector<File>().swap(vecWorkerKept);
+         }
+
+         // oldest on top
+         std::make_heap(vecFiles.begin(), vecFiles.end(), IsNewer);
+         std::vector<File> vecVictims;
+         while (uTotalSize > m_Policy.uMaxTotalSize && !vecFiles.empty())
+         {
+            std::pop_heap(vecFiles.begin(), vecFiles.end(), IsNewer);
+            uTotalSize -= vecFiles.back().uSize;
+            vecVictims.push_back(std::move(vecFiles.back()));
+            vecFiles.pop_back();
+         }
+         return DeleteVictims(vecVictims);
+      }
+
+      // the victims are unlinked relatively to their folder's descriptor, used for all its victims
+      // (when pruning, the folders emptied and their parents left empty are then removed)
+      size_t DeleteVictims(std::vector<File>& vecVictims) const
+      {
+         std::sort(vecVictims.begin(), vecVictims.end(),
+            [](const File& A, const File& B) { return A.pFolder < B.pFolder; });
+
+         size_t uDeleted = 0;
+         for (auto itVictim = vecVictims.begin(); itVictim != vecVictims.end(); )
+         {
+            const Folder& Dir = *itVictim->pFolder;
+            const FolderHandlePtr pDirHandle = GetHandle(Dir);
+            for (; itVictim != vecVictims.end() && itVictim->pFolder == &Dir; ++itVictim)
+            {
+               if (pDirHandle)
+                  uDeleted += Delete(pDirHandle->Get(), Dir.strPath, *itVictim) ? 1 : 0;
+               else
+                  std::cerr << "[ERROR][Directory::CleanUpFiles] File '" + Dir.strPath + '/' + itVictim->strName
+                     + "' could not be deleted.\n" << std::flush;
+            }
+
+            for (const Folder* pEmptied = &Dir; m_bPrune && pEmptied->pParent; pEmptied = pEmptied->pParent)
+            {
+               const FolderHandlePtr pParentHandle = GetHandle(*pEmptied->pParent);
+               if (!pParentHandle || !Prune(pParentHandle->Get(), *pEmptied))
+                  break;
+            }
+         }
+         return uDeleted;
+      }
+
+      const size_t m_uThreads;
+      const bool m_bRecursive;
+      const bool m_bPrune;
+      const Policy m_Policy;
+      int m_iRootFd;
+      std::atomic<size_t> m_uHandles; // kept by the folders for the quota
+      size_t m_uMaxHandles;
+   };
+}
+#endif
+
+/**
+ * @brief removes a folder and its content (or a file), like fs::remove_all
+ *
+ * With several threads, the folders are emptied in parallel (under Linux only) : the removal still
+ * stops at the first failure, but the entries removed by the other threads until then are counted too.
+ *
+ * @param path of the folder
+ * @param false if an entry couldn't be removed (the removal stops there)
+ * @param count of threads removing the entries
+ *
+ * @return count of removed entries (the folder included), 0 if it didn't exist
+ */
+const size_t Directory::EraseFolder(const std::string& strFolderPath, bool& bSuccess, const size_t uThreads)
+{
+   uintmax_t uDeletedItems = 0;
+   bSuccess = true;
+   #ifdef LINUX
+   // the entries are removed relatively to their folder's descriptor : the cost of a removal
+   // doesn't depend on the depth of the entry
+   ScopedIdlePriority Priority;
+   std::string strPath = strFolderPath; // entry that couldn't be removed
+   struct stat Stat;
+   if (lstat(strFolderPath.c_str(), &Stat) != 0)
+   {
+      if (errno == ENOENT)
+         return 0;
+      bSuccess = false;
+   }
+   else if (!S_ISDIR(Stat.st_mode))
+   {
+      ThrottleRemoval(AT_FDCWD, strFolderPath.c_str(), S_ISREG(Stat.st_mode) ? Stat.st_size : 0);
+      if (unlink(strFolderPath.c_str()) == 0)
+         uDeletedItems = 1;
+      else
+         bSuccess = false;
+   }
+   else if (uThreads > 1)
+   {
+      ParallelRemover Remover(uThreads);
+      bSuccess = Remover.Remove(strFolderPath);
+      if (!bSuccess)
+         strPath = Remover.GetFailedPath();
+      uDeletedItems = Remover.GetRemovedCount();
+   }
+   else
+   {
+      size_t uRemoved = 0;
+      int iDirFd = open(strFolderPath.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+      if (iDirFd >= 0)
+      {
+         std::unique_ptr<char[]> pBuffer(new char[DENTS_BUFFER_SIZE]);
+         bSuccess = RemoveFolderContent(iDirFd, strPath, pBuffer.get(), uRemoved);
+         close(iDirFd);
+         if (bSuccess)
+            IoThrottle::GetInstance().Acquire(1, 0);
+         if (bSuccess && rmdir(strFolderPath.c_str()) == 0)
+            ++uRemoved;
+         else
+            bSuccess = false;
+      }
+      else
+         bSuccess = false;
+      uDeletedItems = uRemoved;
+   }
+
+   if (!bSuccess)
+      std::cout << "[ERROR][Directory::EraseFolder] '" << strPath << "' could not be removed : "
+                << strerror(errno) << std::endl;
+   #else
+   try
+   {
+      uDeletedItems = fs::remove_all(strFolderPath);
+   }
+   catch (const fs::filesystem_error& ex)
+   {
+      bSuccess = false;
+      std::cout << ex.what() << std::endl;
+   }
+   #endif
+   return uDeletedItems;
+}
+
+/**
+ * @brief removes a folder in the background (FolderReaper) : it is renamed into the trash of its file
+ * system, so that its path is free once the method returns
+ *
+ * @param path of the folder
+ *
+ * @return false if the folder exists but couldn't be moved nor removed
+ */
+const bool Directory::EraseFolderAsync(const std::string& strFolderPath)
+{
+   return FolderReaper::GetInstance().Trash(strFolderPath);
+}
 
 // Effects: Renames old_p to new_p, as if by POSIX rename().
 const bool Directory::Rename(const std::string& strFilePath, const std::string& strNewName)
@@ -400,6 +1842,15 @@ const size_t Directory::FileSize(const std::string& strFile, bool& bSuccess)
 {
    size_t usCount = 0;
    bSuccess = false;
+   #ifdef LINUX
+   // a single stat gives both the type and the size
+   struct stat Stat;
+   if (stat(strFile.c_str(), &Stat) == 0 && S_ISREG(Stat.st_mode))
+   {
+      usCount = Stat.st_size;
+      bSuccess = true;
+   }
+   #else
    try
    {
       if (IsFile(strFile))
@@ -412,6 +1863,7 @@ const size_t Directory::FileSize(const std::string& strFile, bool& bSuccess)
    {
       std::cout << ex.what() << std::endl;
    }
+   #endif
    return usCount;
 }
 
@@ -422,133 +1874,369 @@ std::time_t Directory::GetLastWriteTime(const std::string& strFilePath)
    return fs::last_write_time(strFilePath);
 }
 
+namespace
+{
+   // adds the folder of a deleted file (relative path) to the folders to prune, unless it is the root or the
+   // last one added (the files of a folder are mostly deleted together)
+   void AddParentFolder(const char* pszRelativePath, std::vector<std::string>& vecFolders)
+   {
+      const char* pszSeparator = nullptr;
+      for (const char* pszChar = pszRelativePath; *pszChar; ++pszChar)
+      {
+         if (*pszChar == '/' || *pszChar == '\\')
+            pszSeparator = pszChar;
+      }
+      if (!pszSeparator)
+         return;
+
+      const size_t uLength = pszSeparator - pszRelativePath;
+      if (vecFolders.empty() || vecFolders.back().compare(0, std::string::npos, pszRelativePath, uLength) != 0)
+         vecFolders.emplace_back(pszRelativePath, uLength);
+   }
+}
+
 const size_t Directory::CleanUpFiles(const std::string& strDirectory, const size_t& usKeepDays, const bool& bRecursive)
+{
+   CleanUpOptions Options;
+   Options.bRecursive = bRecursive;
+   return CleanUpFiles(strDirectory, usKeepDays, Options);
+}
+
+/**
+ * @brief deletes the files last modified more than usKeepDays days ago
+ *
+ * By default the files are listed first, then deleted. With Options.bStreaming, each file is deleted
+ * as soon as the walk reports it : its time comes from the walk's own stat and nothing is kept.
+ * With Options.uThreads > 1 (under Linux), the folders are cleaned up in parallel, the expired files
+ * of a folder being deleted once it is read : only the names of one folder per thread are kept.
+ * With Options.bPruneEmptyFolders, the sub-folders emptied by this pass are removed after their content (with
+ * their parents left empty), the folders which were already empty are kept.
+ *
+ * @param path of the directory
+ * @param age in days of the files to keep
+ * @param recursion and deletion mode
+ *
+ * @return count of deleted files
+ */
+const size_t Directory::CleanUpFiles(const std::string& strDirectory, const size_t& usKeepDays,
+   const CleanUpOptions& Options)
 {
    if (!IsDirectory(strDirectory))
       return 0;
 
+   const bool bRecursive = Options.bRecursive;
+   #ifdef LINUX
+   ScopedIdlePriority Priority;
+   if (Options.uThreads > 1)
+   {
+      ParallelCleaner::Policy CleanUpPolicy;
+      CleanUpPolicy.tLimit = static_cast<std::time_t>(std::time(nullptr) - usKeepDays * 86400);
+      return ParallelCleaner(Options.uThreads, bRecursive, CleanUpPolicy, Options.bPruneEmptyFolders).CleanUp(strDirectory);
+   }
+   #endif
+   if (Options.bStreaming)
+      return CleanUpFilesStreaming(strDirectory, usKeepDays, Options);
+
    size_t usCount = 0;
+   const bool bPrune = bRecursive && Options.bPruneEmptyFolders;
+   std::vector<std::string> vecFolders; // of the deleted files, to prune
    Directory DirList;
+   DirList.SetMetadataCollection(true); // the write times are read during the walk
    DirList.ListFiles(strDirectory, bRecursive);
 
-   for (std::unordered_map<std::string, std::string>::const_iterator itFile = DirList.m_mapFilesAbsRel.cbegin();
-   itFile != DirList.m_mapFilesAbsRel.cend();
-   ++itFile)
+   const std::time_t tLimit = static_cast<std::time_t>(std::time(nullptr) - usKeepDays * 86400);
+   const std::vector<std::time_t>& vecWriteTimes = DirList.m_FilesMetadata.GetModificationTimes();
+
+   #ifdef LINUX
+   // the files are unlinked relatively to their folder's descriptor, opened once for all the
+   // consecutive files of the folder (the listing reports them together, between the subtrees) :
+   // it is reached one component at a time from the descriptors of its ancestors, symbolic links
+   // (e.g. a folder replaced since the listing) aren't followed
+   const int iRootFd = open(strDirectory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+   FolderChain Folders(iRootFd);
+   #endif
+
+   for (size_t uIndex = 0; uIndex < vecWriteTimes.size(); ++uIndex)
    {
-      std::time_t tLastWriteTime = GetLastWriteTime(itFile->first);
-      if (tLastWriteTime < static_cast<std::time_t>(std::time(nullptr) - usKeepDays * 86400))
+      if (vecWriteTimes[uIndex] < tLimit)
       {
-         if (!EraseFile(itFile->first))
-            std::cerr << "[ERROR][Directory::CleanUpFiles] File '" << itFile->first << "' could not be deleted." << std::endl;
+         IoThrottle::GetInstance().Acquire(1, DirList.m_FilesMetadata.GetSize(uIndex));
+         #ifdef LINUX
+         const char* pszRelativePath = DirList.m_Files.GetRelativePath(uIndex);
+         const char* pszName = strrchr(pszRelativePath, '/');
+         const size_t uFolderLength = (pszName) ? pszName - pszRelativePath : 0;
+         pszName = (pszName) ? pszName + 1 : pszRelativePath;
+         const int iFolderFd = Folders.Open(pszRelativePath, uFolderLength);
+         if (iFolderFd >= 0 && unlinkat(iFolderFd, pszName, 0) == 0)
+         {
+            ++usCount;
+            if (bPrune)
+               AddParentFolder(pszRelativePath, vecFolders);
+            continue;
+         }
+         #endif
+
+         // path changed by STD_RELATIVE_PATH or folder that couldn't be opened
+         const std::string strFile = DirList.m_Files.GetAbsolutePath(uIndex);
+         if (!EraseFile(strFile))
+            std::cerr << "[ERROR][Directory::CleanUpFiles] File '" << strFile << "' could not be deleted." << std::endl;
          else
+         {
             ++usCount;
+            if (bPrune)
+               AddParentFolder(DirList.m_Files.GetRelativePath(uIndex), vecFolders);
+         }
       }
    }
+
+   #ifdef LINUX
+   if (iRootFd >= 0)
+      close(iRootFd);
+   #endif
+
+   PruneEmptyFolders(strDirectory, vecFolders);
    return usCount;
 }
 
+const size_t Directory::ApplyRetention(const std::string& strDirectory, const RetentionPolicy& Policy)
+{
+   return ApplyRetention(strDirectory, Policy, CleanUpOptions());
+}
+
 /**
- * @brief lists all the folders of a directory
+ * @brief deletes the files of a directory according to a retention policy : the files older than
+ * the age limit, then the older files of each folder beyond the count to keep, then the oldest files
+ * until the total size of the remaining ones fits in the quota
+ *
+ * Files are never fully sorted : a partial sort per folder, and a heap of the kept files for the quota.
  *
  * @param path of the directory
+ * @param retention criteria
+ * @param recursion and threads (Options.bStreaming doesn't apply : the files are deleted during the walk)
  *
- * @return string containing folders listing
+ * @return count of deleted files
  */
-std::string Directory::ListFolders(const std::string& strLocation, bool bRecursive, PathType ePathType)
+const size_t Directory::ApplyRetention(const std::string& strDirectory, const RetentionPolicy& Policy,
+   const CleanUpOptions& Options)
 {
-   std::string strRelativePath;
-   std::string strAbsolutePath;
-   std::string strList;
-   fs::path PathDir(strLocation);
-   std::string strLoc = PathDir.make_preferred().string();
+   if (!IsDirectory(strDirectory))
+      return 0;
 
-   m_mapFoldersRelAbs.clear();
-   m_mapFoldersAbsRel.clear();
-   m_mapSortedFoldersAbsRel.clear();
-   m_mapSortedFoldersRelAbs.clear();
+   const std::time_t tLimit = (Policy.uMaxAgeDays == SIZE_MAX) ? std::numeric_limits<std::time_t>::min()
+      : static_cast<std::time_t>(std::time(nullptr) - Policy.uMaxAgeDays * 86400);
 
-   if (strLoc.empty() || !IsDirectory(strLocation))
-      return "";
-   
-   if (bRecursive)
+   #ifdef LINUX
+   ScopedIdlePriority Priority;
+   ParallelCleaner::Policy CleanUpPolicy;
+   CleanUpPolicy.tLimit = tLimit;
+   CleanUpPolicy.uKeepPerFolder = Policy.uKeepPerFolder;
+   CleanUpPolicy.uMaxTotalSize = Policy.uMaxTotalSize;
+   return ParallelCleaner(std::max<size_t>(Options.uThreads, 1), Options.bRecursive, CleanUpPolicy,
+      Options.bPruneEmptyFolders).CleanUp(strDirectory);
+   #else
+   struct File
    {
-      for (fs::recursive_directory_iterator itDir(PathDir), itEnd; itDir != itEnd; ++itDir)
-      {
-         if (fs::is_directory(*itDir))
-         {
-            strAbsolutePath = itDir->path().string();
-            strRelativePath = itDir->path().string();
-            //strRelativePath.erase(0, strLoc.length() - 1); // -1 to spare the '/' or the '\'
-            strRelativePath.erase(0, strLoc.length());
-
-            #ifdef STD_RELATIVE_PATH
-            if (strRelativePath.find_first_of('\\') != std::string::npos) // only for paths under a Windows based system
-            { // to transform the path to a standardized one in order to compare it with the distant paths (NetExplorer platform)
-               boost::replace_all(strRelativePath, "\\", "/");
-            }
-            #endif
-
-            m_mapFoldersAbsRel.insert(std::pair<std::string, std::string>(strAbsolutePath, strRelativePath));
-            m_mapSortedFoldersAbsRel.insert(std::pair<std::string, std::string>(strAbsolutePath, strRelativePath));
-            m_mapFoldersRelAbs.insert(std::pair<std::string, std::string>(strRelativePath, strAbsolutePath));
-            m_mapSortedFoldersRelAbs.insert(std::pair<std::string, std::string>(strRelativePath, strAbsolutePath));
+      std::string strPath;
+      std::time_t tModificationTime;
+      uint64_t uSize;
+      size_t uRelativeOffset; // of the relative path in strPath
+   };
+   // newest first, the paths break ties
+   auto IsNewer = [](const File& A, const File& B)
+   {
+      return A.tModificationTime > B.tModificationTime
+         || (A.tModificationTime == B.tModificationTime && A.strPath > B.strPath);
+   };
 
-            switch (ePathType)
-            {
-               case ABSOLUTE_PATH:
-               default:
-                  strList.append(strAbsolutePath);
-                  strList.append("\n");
-                  break;
-               case RELATIVE_PATH:
-                  strList.append(strRelativePath);
-                  strList.append("\n");
-                  break;
-            }
-         }
+   std::unordered_map<std::string, std::vector<File>> mapFolders;
+   std::vector<std::string> vecFolders; // of the deleted files, to prune
+   const bool bPrune = Options.bRecursive && Options.bPruneEmptyFolders;
+   WalkOptions WalkOpts;
+   WalkOpts.bRecursive = Options.bRecursive;
+   WalkOpts.bMetadata = true;
+   Walk(strDirectory, WalkOpts, [&](const WalkEntry& Entry)
+   {
+      if (Entry.eType == FILE_ENTRY)
+      {
+         const size_t uSeparator = Entry.strAbsolutePath.find_last_of("/\\");
+         mapFolders[Entry.strAbsolutePath.substr(0, uSeparator)].push_back({ Entry.strAbsolutePath,
+            Entry.pMetadata->tModificationTime, Entry.pMetadata->uSize,
+            static_cast<size_t>(Entry.pszRelativePath - Entry.strAbsolutePath.c_str()) });
       }
-   }
-   else
+      return true;
+   });
+
+   size_t usCount = 0;
+   auto Delete = [&](const File& Victim)
    {
-      for (fs::directory_iterator itDir(PathDir), itEnd; itDir != itEnd; ++itDir)
+      IoThrottle::GetInstance().Acquire(1, Victim.uSize);
+      if (!EraseFile(Victim.strPath))
+         std::cerr << "[ERROR][Directory::CleanUpFiles] File '" << Victim.strPath << "' could not be deleted." << std::endl;
+      else
       {
-         if (fs::is_directory(*itDir))
-         {
-            strAbsolutePath = itDir->path().string();
-            strRelativePath = itDir->path().string();
-            //strRelativePath.erase(0, strLoc.length() - 1); // -1 to spare the '/' or the '\'
-            strRelativePath.erase(0, strLoc.length());
+         ++usCount;
+         if (bPrune)
+            AddParentFolder(Victim.strPath.c_str() + Victim.uRelativeOffset, vecFolders);
+      }
+   };
 
+   std::vector<File> vecKept;
+   uint64_t uTotalSize = 0;
+   for (auto& Folder : mapFolders)
+   {
+      std::vector<File>& vecFiles = Folder.second;
+      auto itKept = std::partition(vecFiles.begin(), vecFiles.end(),
+         [tLimit](const File& Candidate) { return Candidate.tModificationTime >= tLimit; });
+      if (static_cast<size_t>(itKept - vecFiles.begin()) > Policy.uKeepPerFolder)
+      {
+         std::nth_element(vecFiles.begin(), vecFiles.begin() + Policy.uKeepPerFolder, itKept, IsNewer);
+         itKept = vecFiles.begin() + Policy.uKeepPerFolder;
+      }
+      std::for_each(itKept, vecFiles.end(), Delete);
+      for (auto itFile = vecFiles.begin(); itFile != itKept; ++itFile)
+      {
+         uTotalSize += itFile->uSize;
+         vecKept.push_back(std::move(*itFile));
+      }
+   }
 
-            #ifdef STD_RELATIVE_PATH
-            // transform the path to a standardized one in order to compare it with the distant paths for example.
-            if (strRelativePath.find_first_of('\\') != std::string::npos) // only for paths under a Windows based system
-            {
-               boost::replace_all(strRelativePath, "\\", "/");
-            }
-            #endif
+   // oldest on top
+   std::make_heap(vecKept.begin(), vecKept.end(), IsNewer);
+   while (uTotalSize > Policy.uMaxTotalSize && !vecKept.empty())
+   {
+      std::pop_heap(vecKept.begin(), vecKept.end(), IsNewer);
+      uTotalSize -= vecKept.back().uSize;
+      Delete(vecKept.back());
+      vecKept.pop_back();
+   }
+   PruneEmptyFolders(strDirectory, vecFolders);
+   return usCount;
+   #endif
+}
 
-            m_mapFoldersAbsRel.insert(std::pair<std::string, std::string>(strAbsolutePath, strRelativePath));
-            m_mapSortedFoldersAbsRel.insert(std::pair<std::string, std::string>(strAbsolutePath, strRelativePath));
-            m_mapFoldersRelAbs.insert(std::pair<std::string, std::string>(strRelativePath, strAbsolutePath));
-            m_mapSortedFoldersRelAbs.insert(std::pair<std::string, std::string>(strRelativePath, strAbsolutePath));
+// the walk's filter only reports the expired files (one stat per file), deleted relatively to the
+// descriptor of their folder while the walk is reading it
+const size_t Directory::CleanUpFilesStreaming(const std::string& strDirectory, const size_t& usKeepDays,
+   const CleanUpOptions& Options)
+{
+   const std::time_t tLimit = static_cast<std::time_t>(std::time(nullptr) - usKeepDays * 86400);
+   WalkOptions WalkOpts;
+   WalkOpts.bRecursive = Options.bRecursive;
+   WalkOpts.Filter.SetModificationTimeRange(std::numeric_limits<std::time_t>::min(), tLimit - 1);
+   WalkOpts.bMetadata = IoThrottle::GetInstance().LimitsBytes(); // same stat as the filter's
 
-            switch (ePathType)
-            {
-               case ABSOLUTE_PATH:
-               default:
-                  strList.append(strAbsolutePath);
-                  strList.append("\n");
-                  break;
-               case RELATIVE_PATH:
-                  strList.append(strRelativePath);
-                  strList.append("\n");
-                  break;
-            }
+   size_t usCount = 0;
+   std::vector<std::string> vecFolders; // of the deleted files, to prune
+   const bool bPrune = Options.bRecursive && Options.bPruneEmptyFolders;
+   Walk(strDirectory, WalkOpts, [&](const WalkEntry& Entry)
+   {
+      if (Entry.eType != FILE_ENTRY)
+         return true;
+
+      IoThrottle::GetInstance().Acquire(1, (Entry.pMetadata) ? Entry.pMetadata->uSize : 0);
+      #ifdef LINUX
+      const size_t uNameOffset = Entry.strAbsolutePath.rfind('/') + 1;
+      bool bDeleted = (Entry.iFolderFd >= 0
+         && unlinkat(Entry.iFolderFd, Entry.strAbsolutePath.c_str() + uNameOffset, 0) == 0);
+      #else
+      bool bDeleted = false;
+      #endif
+
+      if (!bDeleted)
+         bDeleted = EraseFile(Entry.strAbsolutePath);
+      if (!bDeleted)
+         std::cerr << "[ERROR][Directory::CleanUpFiles] File '" << Entry.strAbsolutePath << "' could not be deleted."
+                   << std::endl;
+      else
+      {
+         ++usCount;
+         if (bPrune)
+            AddParentFolder(Entry.pszRelativePath, vecFolders);
+      }
+      return true;
+   });
+   PruneEmptyFolders(strDirectory, vecFolders);
+   return usCount;
+}
+
+/**
+ * @brief removes the given folders of a directory if they are empty, then their parents left empty (the
+ * directory itself is kept) : sorted like SlashOccurrencesComparison, the folders are handled in reverse
+ * order, after their own sub-folders. Under Linux, a folder is removed relatively to its parent's descriptor,
+ * reached one component at a time from the directory's one without following symbolic links : the descriptors
+ * of the ancestors are kept for the next folders.
+ *
+ * @param path of the directory
+ * @param paths relative to the directory of the folders where files were deleted (sorted in place)
+ *
+ * @return count of removed folders
+ */
+const size_t Directory::PruneEmptyFolders(const std::string& strDirectory, std::vector<std::string>& vecFolders)
+{
+   if (vecFolders.empty())
+      return 0;
+   SortPaths(vecFolders);
+   vecFolders.erase(std::unique(vecFolders.begin(), vecFolders.end()), vecFolders.end());
+
+   size_t uRemoved = 0;
+   #ifdef LINUX
+   const int iRootFd = open(strDirectory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+   FolderChain Parents(iRootFd);
+   for (auto itFolder = vecFolders.rbegin(); iRootFd >= 0 && itFolder != vecFolders.rend(); ++itFolder)
+   {
+      // up to the first folder which isn't empty
+      for (std::string strFolder = *itFolder; !strFolder.empty(); )
+      {
+         const size_t uSeparator = strFolder.rfind('/');
+         const size_t uParentLength = (uSeparator == std::string::npos) ? 0 : uSeparator;
+         const int iParentFd = Parents.Open(strFolder.c_str(), uParentLength);
+         if (iParentFd < 0)
+            break;
+
+         const char* pszName = strFolder.c_str() + ((uSeparator == std::string::npos) ? 0 : uSeparator + 1);
+         IoThrottle::GetInstance().Acquire(1, 0);
+         if (unlinkat(iParentFd, pszName, AT_REMOVEDIR) != 0)
+         {
+            // ENOENT : already removed with the sub-folders of another folder
+            if (errno != ENOTEMPTY && errno != EEXIST && errno != ENOENT)
+               std::cerr << "[ERROR][Directory::CleanUpFiles] Folder '" << strDirectory << '/' << strFolder
+                         << "' could not be removed." << std::endl;
+            break;
          }
+         ++uRemoved;
+         strFolder.resize(uParentLength);
+      }
+   }
+
+   if (iRootFd >= 0)
+      close(iRootFd);
+   #else
+   const fs::path Root(strDirectory);
+   for (auto itFolder = vecFolders.rbegin(); itFolder != vecFolders.rend(); ++itFolder)
+   {
+      for (fs::path Folder(*itFolder); !Folder.empty(); Folder = Folder.parent_path())
+      {
+         IoThrottle::GetInstance().Acquire(1, 0);
+         boost::system::error_code ec;
+         if (!fs::is_empty(Root / Folder, ec) || ec || !fs::remove(Root / Folder, ec))
+            break;
+         ++uRemoved;
       }
    }
-	return strList;
+   #endif
+   return uRemoved;
+}
+
+/**
+ * @brief lists all the folders of a directory
+ *
+ * @param path of the directory
+ *
+ * @return string containing folders listing
+ */
+std::string Directory::ListFolders(const std::string& strLocation, bool bRecursive, PathType ePathType)
+{
+   return ListEntries(strLocation, bRecursive, ePathType, true, false);
 }
 
 /**
@@ -560,102 +2248,2702 @@ std::string Directory::ListFolders(const std::string& strLocation, bool bRecursi
  */
 std::string Directory::ListFiles(const std::string& strLocation, bool bRecursive, PathType ePathType)
 {
-   std::string strRelativePath;
-   std::string strAbsolutePath;
+   return ListEntries(strLocation, bRecursive, ePathType, false, true);
+}
+
+/**
+ * @brief lists the folders and the files of a directory in a single traversal
+ *
+ * fills the folders and the files maps exactly like ListFolders followed by ListFiles
+ * would do, but the directory is only walked (and each entry only stat'ed) once.
+ *
+ * @param path of the directory
+ *
+ * @return string containing folders and files listing (in traversal order)
+ */
+std::string Directory::ListTree(const std::string& strLocation, bool bRecursive, PathType ePathType)
+{
+   return ListEntries(strLocation, bRecursive, ePathType, true, true);
+}
+
+std::string Directory::ListEntries(const std::string& strLocation, bool bRecursive, PathType ePathType,
+   bool bFolders, bool bFiles)
+{
    std::string strList;
    fs::path PathDir(strLocation);
    std::string strLoc = PathDir.make_preferred().string();
 
-   m_mapFilesRelAbs.clear();
-   m_mapFilesAbsRel.clear();
-   m_mapSortedFilesAbsRel.clear();
-   m_mapSortedFilesRelAbs.clear();
+   if (bFolders)
+      ClearFolders();
+   if (bFiles)
+      ClearFiles();
 
+   m_Times = Statistics();
    if (strLoc.empty() || !IsDirectory(strLocation))
       return "";
+   m_strLocation = strLoc;
+   m_bRecursive = bRecursive;
+
+   WalkStats Stats;
+   WalkOptions Options;
+   Options.bRecursive = bRecursive;
+   Options.uThreads = m_uThreads;
+   Options.bMetadata = m_bMetadata;
+   Options.Filter = m_Filter;
+   Options.pStats = &Stats;
 
-   if (bRecursive)
    {
-      for (fs::recursive_directory_iterator itDir(PathDir), itEnd; itDir != itEnd; ++itDir)
+      ScopedTimer Timer(&m_Times.uListingNanoseconds);
+      Walk(strLoc, Options, [&](const WalkEntry& Entry)
       {
-         if (fs::is_regular_file(*itDir))
-         {
-            strAbsolutePath = itDir->path().string();
-            strRelativePath = itDir->path().string();
-            
-            if (strLoc[strLoc.length() - 1] == '/' // It occured only once on Ubuntu, but let's stay careful...
-               || strLoc[strLoc.length() - 1] == '\\') // Never occur under Windows 10 with Boost 1.60.0
-               strRelativePath.erase(0, strLoc.length()); // +1 to remove the slash preceding the file name
-            else
-               strRelativePath.erase(0, strLoc.length() + 1); // +1 to remove the slash preceding the file name
+         AddEntry(Entry.strAbsolutePath, Entry.eType, Entry.pMetadata, strLoc, ePathType, bFolders, bFiles, strList);
+         return true;
+      });
+   }
+   m_Times.uReadDirNanoseconds = Stats.uReadDirNanoseconds;
+   m_Times.uStatNanoseconds = Stats.uStatNanoseconds;
+   m_Times.uErrors = Stats.uErrors;
+   return strList;
+}
 
-            #ifdef STD_RELATIVE_PATH
-            if (strRelativePath.find_first_of('\\') != std::string::npos) // only for paths under a Windows based system
-            { // to transform the path to a standardized one in order to compare it with the distant paths (NetExplorer platform)
-               boost::replace_all(strRelativePath, "\\", "/");
-            }
-            #endif
+/**
+ * @brief visits the entries of a directory without storing them
+ *
+ * Visitor is called for each entry (folders and files but also other entries like sockets,
+ * check WalkEntry::eType) in the same order as the listing methods. Memory doesn't depend on
+ * the size of the tree (unless Options.uThreads > 1 : the parallel walk keeps the entries
+ * to report them in that order).
+ *
+ * @param path of the directory
+ * @param walk options (recursion, threads, filter)
+ * @param called with each entry, returns false to stop the walk
+ *
+ * @return false if the directory couldn't be opened
+ */
+const bool Directory::Walk(const std::string& strRoot, const WalkOptions& Options, const WalkVisitor& Visitor)
+{
+   if (strRoot.empty())
+      return false;
 
-            m_mapFilesAbsRel.insert(std::pair<std::string, std::string>(strAbsolutePath, strRelativePath));
-            m_mapSortedFilesAbsRel.insert(std::pair<std::string, std::string>(strAbsolutePath, strRelativePath));
-            m_mapFilesRelAbs.insert(std::pair<std::string, std::string>(strRelativePath, strAbsolutePath));
-            m_mapSortedFilesRelAbs.insert(std::pair<std::string, std::string>(strRelativePath, strAbsolutePath));
+   // relative paths start after the separator following the root
+   const size_t uRelativeOffset = strRoot.length()
+      + ((strRoot[strRoot.length() - 1] == '/' || strRoot[strRoot.length() - 1] == '\\') ? 0 : 1);
 
-            switch (ePathType)
-            {
-               case ABSOLUTE_PATH:
-               default:
-                  strList.append(strAbsolutePath);
-                  strList.append("\n");
-                  break;
-               case RELATIVE_PATH:
-                  strList.append(strRelativePath);
-                  strList.append("\n");
-                  break;
-            }
+   #ifdef LINUX
+   int iDirFd = open(strRoot.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+   if (iDirFd < 0)
+      return false;
+
+   auto OnEntry = [&](const std::string& strAbsolutePath, EntryType eType, const EntryMetadata* pMetadata, int iFolderFd)
+   {
+      const WalkEntry Entry = { strAbsolutePath, strAbsolutePath.c_str() + uRelativeOffset, eType, pMetadata, iFolderFd };
+      return Visitor(Entry);
+   };
+   if (Options.bRecursive && Options.uThreads > 1)
+      ParallelDentsWalker(Options.uThreads, Options.bMetadata, Options.Filter, Options.pStats).Walk(iDirFd, strRoot, OnEntry);
+   else
+      DentsWalker(Options.bRecursive, Options.bMetadata, Options.Filter, Options.pStats).Walk(iDirFd, strRoot, OnEntry);
+   close(iDirFd);
+   #else
+   fs::path PathDir(strRoot);
+   if (!IsDirectory(strRoot))
+      return false;
+
+   const WalkFilter& Filter = Options.Filter;
+   // returns 0 to skip the entry, 1 to report it, -1 to stop the walk
+   auto OnEntry = [&](const fs::directory_entry& DirEntry)
+   {
+      const std::string strAbsolutePath = DirEntry.path().string();
+      const std::string strName = DirEntry.path().filename().string();
+      const EntryType eType = GetEntryType(DirEntry.status());
+      if (eType == FOLDER_ENTRY && Filter.IsFolderExcluded(strName.c_str()))
+         return 0;
+      if (eType != FOLDER_ENTRY && !Filter.IsFileNameAccepted(strName.c_str()))
+         return 0;
+
+      EntryMetadata Metadata = EntryMetadata();
+      if (Options.bMetadata || (Filter.NeedsStat() && eType == FILE_ENTRY))
+      {
+         ScopedTimer Timer(StatTime(Options.pStats));
+         boost::system::error_code ec;
+         if (eType == FILE_ENTRY)
+         {
+            const uintmax_t uSize = fs::file_size(DirEntry.path(), ec);
+            Metadata.uSize = (ec) ? 0 : uSize;
+            if (ec)
+               AddError(Options.pStats);
          }
+         Metadata.tModificationTime = fs::last_write_time(DirEntry.path(), ec);
+         if (ec)
+            AddError(Options.pStats);
+         Metadata.uMode = DirEntry.status().permissions();
+      }
+      if (eType != FOLDER_ENTRY && Filter.NeedsStat()
+         && (eType != FILE_ENTRY || !Filter.IsFileStatAccepted(Metadata.uSize, Metadata.tModificationTime)))
+         return 0;
+
+      const WalkEntry Entry = { strAbsolutePath, strAbsolutePath.c_str() + uRelativeOffset, eType,
+                                (Options.bMetadata) ? &Metadata : nullptr, -1 };
+      return Visitor(Entry) ? 1 : -1;
+   };
+   // the iterators read the folders while they are incremented
+   uint64_t* pReadDirTime = ReadDirTime(Options.pStats);
+   if (Options.bRecursive)
+   {
+      for (fs::recursive_directory_iterator itDir(PathDir), itEnd; itDir != itEnd; )
+      {
+         const int iResult = OnEntry(*itDir);
+         if (iResult < 0)
+            break;
+         // skipped folders and the ones at the maximum depth are not read, nor the other entries (the
+         // visitor may have removed them)
+         if (iResult == 0 || !Filter.CanDescend(itDir.level() + 1) || !fs::is_directory(itDir->symlink_status()))
+            itDir.no_push();
+         ScopedTimer Timer(pReadDirTime);
+         ++itDir;
+      }
+   }
+   else
+   {
+      for (fs::directory_iterator itDir(PathDir), itEnd; itDir != itEnd; )
+      {
+         if (OnEntry(*itDir) < 0)
+            break;
+         ScopedTimer Timer(pReadDirTime);
+         ++itDir;
+      }
+   }
+   #endif
+   return true;
+}
+
+Directory::EntryType Directory::GetEntryType(const fs::file_status& Status)
+{
+   if (fs::is_directory(Status))
+      return FOLDER_ENTRY;
+   if (fs::is_regular_file(Status))
+      return FILE_ENTRY;
+   return OTHER_ENTRY;
+}
+
+Directory::WalkFilter& Directory::WalkFilter::AddPattern(const std::string& strPattern)
+{
+   if (!strPattern.empty())
+      m_vecPatterns.push_back(Compile(strPattern));
+   return *this;
+}
+
+Directory::WalkFilter& Directory::WalkFilter::AddExtension(const std::string& strExtension)
+{
+   const std::string strExt = (!strExtension.empty() && strExtension[0] == '.') ? strExtension.substr(1) : strExtension;
+   if (!strExt.empty())
+      m_setExtensions.insert(strExt);
+   return *this;
+}
+
+Directory::WalkFilter& Directory::WalkFilter::ExcludeFolder(const std::string& strPattern)
+{
+   if (strPattern.empty())
+      return *this;
+
+   Pattern CompiledPattern = Compile(strPattern);
+   if (CompiledPattern.eKind == Pattern::EXACT)
+      m_setExcludedNames.insert(CompiledPattern.strText);
+   else
+      m_vecExcludedPatterns.push_back(CompiledPattern);
+   return *this;
+}
+
+Directory::WalkFilter& Directory::WalkFilter::SetSizeRange(const uint64_t uMinSize, const uint64_t uMaxSize)
+{
+   m_bSizeRange = true;
+   m_uMinSize = uMinSize;
+   m_uMaxSize = uMaxSize;
+   return *this;
+}
+
+Directory::WalkFilter& Directory::WalkFilter::SetModificationTimeRange(const std::time_t tFrom, const std::time_t tTo)
+{
+   m_bTimeRange = true;
+   m_tFrom = tFrom;
+   m_tTo = tTo;
+   return *this;
+}
+
+Directory::WalkFilter& Directory::WalkFilter::SetMaxDepth(const size_t uMaxDepth)
+{
+   m_uMaxDepth = uMaxDepth;
+   return *this;
+}
+
+const bool Directory::WalkFilter::IsFolderExcluded(const char* pszName) const
+{
+   if (!m_setExcludedNames.empty() && m_setExcludedNames.count(pszName) != 0)
+      return true;
+
+   const size_t uLength = strlen(pszName);
+   for (const Pattern& ExcludedPattern : m_vecExcludedPatterns)
+      if (Match(ExcludedPattern, pszName, uLength))
+         return true;
+   return false;
+}
+
+// a file is accepted if no pattern and no extension were added or if it matches one of them
+const bool Directory::WalkFilter::IsFileNameAccepted(const char* pszName) const
+{
+   if (m_vecPatterns.empty() && m_setExtensions.empty())
+      return true;
+
+   if (!m_setExtensions.empty())
+   {
+      const char* pszExtension = strrchr(pszName, '.');
+      if (pszExtension != nullptr && m_setExtensions.count(pszExtension + 1) != 0)
+         return true;
+   }
+
+   const size_t uLength = strlen(pszName);
+   for (const Pattern& NamePattern : m_vecPatterns)
+      if (Match(NamePattern, pszName, uLength))
+         return true;
+   return false;
+}
+
+const bool Directory::WalkFilter::IsFileStatAccepted(const uint64_t uSize, const std::time_t tModificationTime) const
+{
+   if (m_bSizeRange && (uSize < m_uMinSize || uSize > m_uMaxSize))
+      return false;
+   if (m_bTimeRange && (tModificationTime < m_tFrom || tModificationTime > m_tTo))
+      return false;
+   return true;
+}
+
+// most patterns are a name, "prefix*" or "*.ext" : they are matched without the wildcards algorithm
+Directory::WalkFilter::Pattern Directory::WalkFilter::Compile(const std::string& strPattern)
+{
+   Pattern CompiledPattern;
+   const size_t uWildcards = std::count(strPattern.begin(), strPattern.end(), '*')
+                           + std::count(strPattern.begin(), strPattern.end(), '?');
+
+   if (uWildcards == 0)
+      CompiledPattern = { Pattern::EXACT, strPattern };
+   else if (uWildcards == 1 && strPattern[0] == '*')
+      CompiledPattern = { Pattern::SUFFIX, strPattern.substr(1) };
+   else if (uWildcards == 1 && strPattern[strPattern.length() - 1] == '*')
+      CompiledPattern = { Pattern::PREFIX, strPattern.substr(0, strPattern.length() - 1) };
+   else
+      CompiledPattern = { Pattern::WILDCARDS, strPattern };
+   return CompiledPattern;
+}
+
+const bool Directory::WalkFilter::Match(const Pattern& CompiledPattern, const char* pszName, const size_t uLength)
+{
+   const std::string& strText = CompiledPattern.strText;
+   switch (CompiledPattern.eKind)
+   {
+      case Pattern::EXACT:
+         return uLength == strText.length() && strText.compare(0, uLength, pszName, uLength) == 0;
+      case Pattern::PREFIX:
+         return uLength >= strText.length() && strText.compare(0, strText.length(), pszName, strText.length()) == 0;
+      case Pattern::SUFFIX:
+         return uLength >= strText.length()
+            && strText.compare(0, strText.length(), pszName + uLength - strText.length(), strText.length()) == 0;
+      case Pattern::WILDCARDS:
+      default:
+         break;
+   }
+
+   // iterative matching, only the last '*' is backtracked to
+   size_t uPattern = 0, uName = 0;
+   size_t uStar = std::string::npos, uStarName = 0;
+   while (uName < uLength)
+   {
+      if (uPattern < strText.length() && (strText[uPattern] == '?' || strText[uPattern] == pszName[uName]))
+      {
+         ++uPattern;
+         ++uName;
+      }
+      else if (uPattern < strText.length() && strText[uPattern] == '*')
+      {
+         uStar = uPattern++;
+         uStarName = uName;
+      }
+      else if (uStar != std::string::npos)
+      {
+         uPattern = uStar + 1;
+         uName = ++uStarName;
       }
+      else
+         return false;
+   }
+   while (uPattern < strText.length() && strText[uPattern] == '*')
+      ++uPattern;
+   return uPattern == strText.length();
+}
+
+void Directory::AddEntry(const std::string& strAbsolutePath, EntryType eType, const EntryMetadata* pMetadata,
+   const std::string& strLoc, PathType ePathType, bool bFolders, bool bFiles, std::string& strList)
+{
+   // the buffer is reused by all the entries
+   std::string& strRelativePath = m_strPathBuffer;
+
+   if (bFolders && eType == FOLDER_ENTRY)
+   {
+      //strRelativePath.assign(strAbsolutePath, strLoc.length() - 1, std::string::npos); // -1 to spare the '/' or the '\\'
+      strRelativePath.assign(strAbsolutePath, strLoc.length(), std::string::npos);
+   }
+   else if (bFiles && eType == FILE_ENTRY)
+   {
+      if (strLoc[strLoc.length() - 1] == '/' // It occured only once on Ubuntu, but let's stay careful...
+         || strLoc[strLoc.length() - 1] == '\\') // Never occur under Windows 10 with Boost 1.60.0
+         strRelativePath.assign(strAbsolutePath, strLoc.length(), std::string::npos); // +1 to remove the slash preceding the file name
+      else
+         strRelativePath.assign(strAbsolutePath, strLoc.length() + 1, std::string::npos); // +1 to remove the slash preceding the file name
+   }
+   else
+      return;
+
+   #ifdef STD_RELATIVE_PATH
+   if (strRelativePath.find_first_of('\\') != std::string::npos) // only for paths under a Windows based system
+   { // to transform the path to a standardized one in order to compare it with the distant paths (NetExplorer platform)
+      boost::replace_all(strRelativePath, "\\", "/");
+   }
+   #endif
+
+   if (eType == FOLDER_ENTRY)
+   {
+      m_Folders.Add(strAbsolutePath, strRelativePath);
+      if (pMetadata)
+         m_FoldersMetadata.Add(*pMetadata);
    }
    else
    {
-      for (fs::directory_iterator itDir(PathDir), itEnd; itDir != itEnd; ++itDir)
+      m_Files.Add(strAbsolutePath, strRelativePath);
+      if (pMetadata)
+         m_FilesMetadata.Add(*pMetadata);
+   }
+
+   switch (ePathType)
+   {
+      case ABSOLUTE_PATH:
+      default:
+         strList.append(strAbsolutePath);
+         strList.append("\n");
+         break;
+      case RELATIVE_PATH:
+         strList.append(strRelativePath);
+         strList.append("\n");
+         break;
+   }
+}
+
+void Directory::ClearFolders()
+{
+   m_Folders.Clear();
+   m_FoldersMetadata.Clear();
+   m_mapFoldersRelAbs.clear();
+   m_mapFoldersAbsRel.clear();
+   m_mapSortedFoldersAbsRel.clear();
+   m_mapSortedFoldersRelAbs.clear();
+   m_mapFoldersRelAbsView.clear();
+   m_mapFoldersAbsRelView.clear();
+   m_mapSortedFoldersAbsRelView.clear();
+   m_mapSortedFoldersRelAbsView.clear();
+   m_FoldersPaths.Clear();
+   m_BuiltMaps.uFlags &= ~FOLDERS_MAPS;
+}
+
+void Directory::ClearFiles()
+{
+   m_Files.Clear();
+   m_FilesMetadata.Clear();
+   m_mapFilesRelAbs.clear();
+   m_mapFilesAbsRel.clear();
+   m_mapSortedFilesAbsRel.clear();
+   m_mapSortedFilesRelAbs.clear();
+   m_mapFilesRelAbsView.clear();
+   m_mapFilesAbsRelView.clear();
+   m_mapSortedFilesAbsRelView.clear();
+   m_mapSortedFilesRelAbsView.clear();
+   m_FilesPaths.Clear();
+   m_BuiltMaps.uFlags &= ~FILES_MAPS;
+}
+
+namespace
+{
+   /**
+    * @brief sorts paths in the SlashOccurrencesComparison order and returns their indexes in that order
+    *
+    * The separators are only counted once per path. When the paths don't contain back-slashes, the
+    * order is depth major : the paths are distributed by their count of '/' (radix pass) and only
+    * the paths of a same depth are compared (those without separator by length first).
+    */
+   template <typename GetPath>
+   std::vector<size_t> SortBySeparators(const size_t uCount, GetPath&& GetPathAt)
+   {
+      typedef Directory::SlashOccurrencesComparison::Key Key;
+      typedef typename std::decay<decltype(GetPathAt(0))>::type Path; // std::string or PooledString
+      struct SortItem
+      {
+         const Path* pPath;
+         Key PathKey;
+         size_t uIndex;
+      };
+
+      std::vector<SortItem> vecItems;
+      vecItems.reserve(uCount);
+      bool bBackSlashes = false;
+      size_t uMaxSlashes = 0;
+      for (size_t uIndex = 0; uIndex < uCount; ++uIndex)
       {
-         if (fs::is_regular_file(*itDir))
+         const Path& strPath = GetPathAt(uIndex);
+         vecItems.push_back(SortItem{ &strPath, Key(strPath), uIndex });
+         bBackSlashes |= (vecItems.back().PathKey.uBackSlashes != 0);
+         uMaxSlashes = std::max(uMaxSlashes, vecItems.back().PathKey.uSlashes);
+      }
+
+      std::vector<size_t> vecOrder;
+      vecOrder.reserve(uCount);
+
+      // mixing separators, the comparison isn't a strict weak ordering : a merge sort is used as it stays
+      // within bounds whatever the comparison results
+      if (bBackSlashes)
+      {
+         std::stable_sort(vecItems.begin(), vecItems.end(), [](const SortItem& A, const SortItem& B)
          {
-            strAbsolutePath = itDir->path().string();
-            strRelativePath = itDir->path().string();
-            if (strLoc[strLoc.length() - 1] == '/' // Ubuntu case
-               || strLoc[strLoc.length() - 1] == '\\') // Didn't occur under Windows 10 with Boost 1.60.0 but let's be careful
-               strRelativePath.erase(0, strLoc.length()); // +1 to remove the slash preceding the file name
-            else
-               strRelativePath.erase(0, strLoc.length() + 1); // +1 to remove the slash preceding the file name
+            return Directory::SlashOccurrencesComparison::Compare(*A.pPath, A.PathKey, *B.pPath, B.PathKey);
+         });
+         for (const SortItem& Item : vecItems)
+            vecOrder.push_back(Item.uIndex);
+         return vecOrder;
+      }
 
-            #ifdef STD_RELATIVE_PATH
-            if (strRelativePath.find_first_of('\\') != std::string::npos) // only for paths under a Windows based system
-            { // to transform the path to a standardized one in order to compare it with the distant paths (NetExplorer platform)
-               boost::replace_all(strRelativePath, "\\", "/");
-            }
-            #endif
+      // counting sort on the depth
+      std::vector<size_t> vecBucketStart(uMaxSlashes + 2, 0);
+      for (const SortItem& Item : vecItems)
+         ++vecBucketStart[Item.PathKey.uSlashes + 1];
+      for (size_t uBucket = 1; uBucket < vecBucketStart.size(); ++uBucket)
+         vecBucketStart[uBucket] += vecBucketStart[uBucket - 1];
 
-            m_mapFilesAbsRel.insert(std::pair<std::string, std::string>(strAbsolutePath, strRelativePath));
-            m_mapSortedFilesAbsRel.insert(std::pair<std::string, std::string>(strAbsolutePath, strRelativePath));
-            m_mapFilesRelAbs.insert(std::pair<std::string, std::string>(strRelativePath, strAbsolutePath));
-            m_mapSortedFilesRelAbs.insert(std::pair<std::string, std::string>(strRelativePath, strAbsolutePath));
+      std::vector<const SortItem*> vecSorted(uCount);
+      std::vector<size_t> vecNext(vecBucketStart.begin(), vecBucketStart.end() - 1);
+      for (const SortItem& Item : vecItems)
+         vecSorted[vecNext[Item.PathKey.uSlashes]++] = &Item;
 
-            switch (ePathType)
+      for (size_t uBucket = 0; uBucket + 1 < vecBucketStart.size(); ++uBucket)
+      {
+         auto itBegin = vecSorted.begin() + vecBucketStart[uBucket];
+         auto itEnd = vecSorted.begin() + vecBucketStart[uBucket + 1];
+         if (uBucket == 0)
+            std::sort(itBegin, itEnd, [](const SortItem* pA, const SortItem* pB)
             {
-               case ABSOLUTE_PATH:
-               default:
-                  strList.append(strAbsolutePath);
-                  strList.append("\n");
-                  break;
-               case RELATIVE_PATH:
-                  strList.append(strRelativePath);
-                  strList.append("\n");
-                  break;
-            }
-         }
+               return (pA->pPath->length() == pB->pPath->length()) ? *pA->pPath < *pB->pPath
+                  : pA->pPath->length() < pB->pPath->length();
+            });
+         else
+            std::sort(itBegin, itEnd, [](const SortItem* pA, const SortItem* pB) { return *pA->pPath < *pB->pPath; });
       }
+
+      for (const SortItem* pItem : vecSorted)
+         vecOrder.push_back(pItem->uIndex);
+      return vecOrder;
    }
-   return strList;
+
+   // fills a flat map with pairs sorted by SortBySeparators
+   template <typename K, typename T>
+   void AssignSorted(FlatSortedMap<K, T, Directory::SlashOccurrencesComparison>& mapPaths,
+      std::vector<std::pair<K, T>>&& vecPairs)
+   {
+      const std::vector<size_t> vecOrder = SortBySeparators(vecPairs.size(),
+         [&](const size_t uIndex) -> const K& { return vecPairs[uIndex].first; });
+      std::vector<std::pair<K, T>> vecSorted;
+      vecSorted.reserve(vecPairs.size());
+
+      // mixing separators, the comparison isn't transitive : the pairs are placed by a tree as they were
+      // in the std::map, so that the order doesn't depend on the container
+      const bool bBackSlashes = std::any_of(vecPairs.cbegin(), vecPairs.cend(),
+         [](const std::pair<K, T>& Pair) { return std::find(Pair.first.begin(), Pair.first.end(), '\\') != Pair.first.end(); });
+      if (bBackSlashes)
+      {
+         std::map<K, T, Directory::SlashOccurrencesComparison> mapTree;
+         for (const size_t uIndex : vecOrder)
+            mapTree.insert(mapTree.end(), std::move(vecPairs[uIndex]));
+         for (auto& Pair : mapTree)
+            vecSorted.emplace_back(Pair.first, std::move(Pair.second));
+      }
+      else
+      {
+         for (const size_t uIndex : vecOrder)
+            vecSorted.push_back(std::move(vecPairs[uIndex]));
+      }
+      mapPaths.assign_sorted(std::move(vecSorted));
+   }
+
+   // each pair owns copies of the paths
+   void FillMap(Directory::HashMap& mapPaths, const Directory::EntryTable& Table,
+      const std::vector<PooledString>& vecAbsolutePaths, const bool bRelativeKeys, uint64_t* /* pSortTime */)
+   {
+      mapPaths.clear();
+      mapPaths.reserve(Table.Size());
+      for (size_t uIndex = 0; uIndex < Table.Size(); ++uIndex)
+      {
+         std::string strRelativePath(Table.GetRelativePath(uIndex), Table.GetRelativePathLength(uIndex));
+         if (bRelativeKeys)
+            mapPaths.emplace(std::move(strRelativePath), vecAbsolutePaths[uIndex].str());
+         else
+            mapPaths.emplace(vecAbsolutePaths[uIndex].str(), std::move(strRelativePath));
+      }
+   }
+
+   // the keys are sorted once (the separators of each key are counted once), then inserted in order
+   void FillMap(Directory::SortedMap& mapPaths, const Directory::EntryTable& Table,
+      const std::vector<PooledString>& vecAbsolutePaths, const bool bRelativeKeys, uint64_t* pSortTime)
+   {
+      std::vector<PooledString> vecRelativePaths;
+      vecRelativePaths.reserve(Table.Size());
+      for (size_t uIndex = 0; uIndex < Table.Size(); ++uIndex)
+         vecRelativePaths.emplace_back(Table.GetRelativePath(uIndex), Table.GetRelativePathLength(uIndex));
+      const std::vector<PooledString>& vecKeys = (bRelativeKeys) ? vecRelativePaths : vecAbsolutePaths;
+      const std::vector<PooledString>& vecValues = (bRelativeKeys) ? vecAbsolutePaths : vecRelativePaths;
+
+      ScopedTimer Timer(pSortTime);
+      const std::vector<size_t> vecOrder = SortBySeparators(vecKeys.size(),
+         [&](const size_t uIndex) -> const PooledString& { return vecKeys[uIndex]; });
+      mapPaths.clear();
+      for (const size_t uIndex : vecOrder)
+         mapPaths.emplace_hint(mapPaths.end(), vecKeys[uIndex].str(), vecValues[uIndex].str());
+   }
+
+   // sized from the table : each relative path is stored with its absolute path
+   void FillMap(Directory::HashMapView& mapPaths, const Directory::EntryTable& Table,
+      const std::vector<PooledString>& vecAbsolutePaths, const bool bRelativeKeys, uint64_t* /* pSortTime */)
+   {
+      mapPaths.reserve(Table.Size(), 2 * Table.GetPoolSize() + Table.Size() * (Table.GetRoot().length() + 5));
+      for (size_t uIndex = 0; uIndex < Table.Size(); ++uIndex)
+      {
+         const char* pszRelativePath = Table.GetRelativePath(uIndex);
+         const size_t uRelativeLength = Table.GetRelativePathLength(uIndex);
+         const PooledString& AbsolutePath = vecAbsolutePaths[uIndex];
+
+         if (bRelativeKeys)
+            mapPaths.insert(pszRelativePath, uRelativeLength, AbsolutePath.data(), AbsolutePath.length());
+         else
+            mapPaths.insert(AbsolutePath.data(), AbsolutePath.length(), pszRelativePath, uRelativeLength);
+      }
+   }
+
+   // the pairs are views of the table's relative paths and of the absolute paths, sorted once (the
+   // separators of each key are counted once)
+   void FillMap(Directory::SortedMapView& mapPaths, const Directory::EntryTable& Table,
+      const std::vector<PooledString>& vecAbsolutePaths, const bool bRelativeKeys, uint64_t* pSortTime)
+   {
+      std::vector<Directory::SortedMapView::value_type> vecPairs;
+      vecPairs.reserve(Table.Size());
+      for (size_t uIndex = 0; uIndex < Table.Size(); ++uIndex)
+      {
+         const PooledString RelativePath(Table.GetRelativePath(uIndex), Table.GetRelativePathLength(uIndex));
+         if (bRelativeKeys)
+            vecPairs.emplace_back(RelativePath, vecAbsolutePaths[uIndex]);
+         else
+            vecPairs.emplace_back(vecAbsolutePaths[uIndex], RelativePath);
+      }
+
+      ScopedTimer Timer(pSortTime);
+      AssignSorted(mapPaths, std::move(vecPairs));
+   }
+}
+
+template <typename Map>
+const Map& Directory::GetMap(Map& mapPaths, const EntryTable& Table, AbsolutePaths& Paths, const bool bRelativeKeys,
+   const unsigned uMapFlag) const
+{
+   if (m_BuiltMaps.uFlags.load(std::memory_order_acquire) & uMapFlag)
+      return mapPaths;
+
+   std::lock_guard<std::mutex> Lock(m_BuiltMaps.Mutex);
+   if (!(m_BuiltMaps.uFlags.load(std::memory_order_relaxed) & uMapFlag))
+   {
+      uint64_t uBuildTime = 0;
+      uint64_t uSortTime = 0;
+      {
+         ScopedTimer Timer(&uBuildTime);
+         // the absolute paths are shared by the maps of the table
+         if (Paths.vecPaths.size() != Table.Size())
+         {
+            Paths.Clear();
+            Paths.vecPaths.reserve(Table.Size());
+            std::string strAbsolutePath;
+            for (size_t uIndex = 0; uIndex < Table.Size(); ++uIndex)
+            {
+               Table.GetAbsolutePath(uIndex, strAbsolutePath);
+               Paths.vecPaths.push_back(Paths.Arena.Store(strAbsolutePath));
+            }
+         }
+         FillMap(mapPaths, Table, Paths.vecPaths, bRelativeKeys, &uSortTime);
+      }
+      m_Times.uSortNanoseconds += uSortTime;
+      m_Times.uMapBuildNanoseconds += uBuildTime - uSortTime;
+      m_BuiltMaps.uFlags.fetch_or(uMapFlag, std::memory_order_release);
+   }
+   return mapPaths;
+}
+
+void Directory::SortPaths(std::vector<std::string>& vecPaths)
+{
+   const std::vector<size_t> vecOrder = SortBySeparators(vecPaths.size(),
+      [&](const size_t uIndex) -> const std::string& { return vecPaths[uIndex]; });
+
+   std::vector<std::string> vecSorted;
+   vecSorted.reserve(vecPaths.size());
+   for (const size_t uIndex : vecOrder)
+      vecSorted.push_back(std::move(vecPaths[uIndex]));
+   vecPaths.swap(vecSorted);
+}
+
+namespace
+{
+   void SetStatus(Directory::PathStatus& Status, const std::string& strPath)
+   {
+      Status = Directory::PathStatus();
+      #ifdef LINUX
+      struct stat Stat;
+      if (stat(strPath.c_str(), &Stat) != 0)
+         return;
+      Status.bExists = true;
+      Status.eType = GetEntryType(Stat.st_mode);
+      SetMetadata(Status.Metadata, Stat);
+      #else
+      boost::system::error_code ec;
+      const fs::file_status FileStatus = fs::status(strPath, ec);
+      if (ec || !fs::exists(FileStatus))
+         return;
+      Status.bExists = true;
+      Status.eType = fs::is_directory(FileStatus) ? Directory::FOLDER_ENTRY
+         : (fs::is_regular_file(FileStatus) ? Directory::FILE_ENTRY : Directory::OTHER_ENTRY);
+      if (Status.eType == Directory::FILE_ENTRY)
+      {
+         const uintmax_t uSize = fs::file_size(strPath, ec);
+         Status.Metadata.uSize = (ec) ? 0 : uSize;
+      }
+      Status.Metadata.tModificationTime = fs::last_write_time(strPath, ec);
+      Status.Metadata.uMode = FileStatus.permissions();
+      #endif
+   }
+
+   // errno the next io_uring_enter fails with (tests)
+   std::atomic<int> g_iStatxRingFailure(0);
+
+   #if defined(LINUX) && defined(IORING_OP_STATX) && defined(__NR_io_uring_setup)
+   /**
+    * @brief minimal io_uring (no liburing) submitting statx requests : a batch of requests is
+    * queued in the submission ring and handed to the kernel with a single io_uring_enter
+    */
+   class StatxRing
+   {
+   public:
+      explicit StatxRing(unsigned uEntries)
+      {
+         struct io_uring_params Params;
+         memset(&Params, 0, sizeof(Params));
+         m_iFd = static_cast<int>(syscall(__NR_io_uring_setup, uEntries, &Params));
+         if (m_iFd < 0)
+            return;
+
+         m_uSqRingSize = Params.sq_off.array + Params.sq_entries * sizeof(unsigned);
+         m_uCqRingSize = Params.cq_off.cqes + Params.cq_entries * sizeof(struct io_uring_cqe);
+         if (Params.features & IORING_FEAT_SINGLE_MMAP)
+            m_uSqRingSize = m_uCqRingSize = std::max(m_uSqRingSize, m_uCqRingSize);
+         m_uSqesSize = Params.sq_entries * sizeof(struct io_uring_sqe);
+
+         m_pSqRing = Map(m_uSqRingSize, IORING_OFF_SQ_RING);
+         m_pCqRing = (Params.features & IORING_FEAT_SINGLE_MMAP) ? m_pSqRing : Map(m_uCqRingSize, IORING_OFF_CQ_RING);
+         m_pSqes = static_cast<struct io_uring_sqe*>(Map(m_uSqesSize, IORING_OFF_SQES));
+         if (!m_pSqRing || !m_pCqRing || !m_pSqes)
+         {
+            Release();
+            return;
+         }
+
+         char* pSq = static_cast<char*>(m_pSqRing);
+         m_pSqHead = reinterpret_cast<unsigned*>(pSq + Params.sq_off.head);
+         m_pSqTail = reinterpret_cast<unsigned*>(pSq + Params.sq_off.tail);
+         m_uSqMask = *reinterpret_cast<unsigned*>(pSq + Params.sq_off.ring_mask);
+         m_pSqArray = reinterpret_cast<unsigned*>(pSq + Params.sq_off.array);
+         char* pCq = static_cast<char*>(m_pCqRing);
+         m_pCqHead = reinterpret_cast<unsigned*>(pCq + Params.cq_off.head);
+         m_pCqTail = reinterpret_cast<unsigned*>(pCq + Params.cq_off.tail);
+         m_uCqMask = *reinterpret_cast<unsigned*>(pCq + Params.cq_off.ring_mask);
+         m_pCqes = reinterpret_cast<struct io_uring_cqe*>(pCq + Params.cq_off.cqes);
+         m_uEntries = Params.sq_entries;
+         m_pBuffers.reset(new struct statx[m_uEntries]);
+      }
+
+      // the ring is torn down before the buffers the kernel writes into are freed
+      ~StatxRing() { Release(); }
+
+      StatxRing(const StatxRing&) = delete;
+      StatxRing& operator=(const StatxRing&) = delete;
+
+      inline bool IsValid() const { return m_iFd >= 0; }
+
+      // stats the paths by batches of the ring's size, returns false if the ring failed
+      // (the statuses must then be obtained otherwise)
+      bool StatAll(const std::vector<std::string>& vecPaths, std::vector<Directory::PathStatus>& vecStatus)
+      {
+         for (size_t uBatch = 0; uBatch < vecPaths.size(); uBatch += m_uEntries)
+         {
+            const unsigned uCount = static_cast<unsigned>(std::min<size_t>(m_uEntries, vecPaths.size() - uBatch));
+
+            const unsigned uFirst = *m_pSqTail;
+            unsigned uTail = uFirst;
+            for (unsigned i = 0; i < uCount; ++i, ++uTail)
+            {
+               const unsigned uSlot = uTail & m_uSqMask;
+               struct io_uring_sqe* pSqe = &m_pSqes[uSlot];
+               memset(pSqe, 0, sizeof(*pSqe));
+               pSqe->opcode = IORING_OP_STATX;
+               pSqe->fd = AT_FDCWD;
+               pSqe->addr = reinterpret_cast<uint64_t>(vecPaths[uBatch + i].c_str());
+               pSqe->len = STATX_TYPE | STATX_MODE | STATX_INO | STATX_SIZE | STATX_MTIME;
+               pSqe->off = reinterpret_cast<uint64_t>(&m_pBuffers[i]);
+               pSqe->statx_flags = AT_NO_AUTOMOUNT;
+               pSqe->user_data = i;
+               m_pSqArray[uSlot] = uSlot;
+            }
+            // the kernel must see the requests before the new tail
+            __atomic_store_n(m_pSqTail, uTail, __ATOMIC_RELEASE);
+
+            for (unsigned uDone = 0; uDone < uCount;)
+            {
+               // requests not consumed yet by the kernel (e.g. interrupted call)
+               const unsigned uToSubmit = uTail - __atomic_load_n(m_pSqHead, __ATOMIC_ACQUIRE);
+               if (Enter(uToSubmit, uCount - uDone) < 0 && !IsTransient(errno))
+               {
+                  // the submitted requests still write into the buffers : they are waited for
+                  const unsigned uSubmitted = __atomic_load_n(m_pSqHead, __ATOMIC_ACQUIRE) - uFirst;
+                  Drain(uSubmitted - uDone);
+                  return false;
+               }
+
+               unsigned uHead = *m_pCqHead;
+               const unsigned uCqTail = __atomic_load_n(m_pCqTail, __ATOMIC_ACQUIRE);
+               for (; uHead != uCqTail; ++uHead, ++uDone)
+               {
+                  const struct io_uring_cqe& Cqe = m_pCqes[uHead & m_uCqMask];
+                  const size_t uIndex = uBatch + Cqe.user_data;
+                  if (Cqe.res == -EINVAL || Cqe.res == -EOPNOTSUPP)
+                     SetStatus(vecStatus[uIndex], vecPaths[uIndex]); // statx not supported by io_uring (Linux < 5.6)
+                  else if (Cqe.res == 0)
+                     SetStatusFromStatx(vecStatus[uIndex], m_pBuffers[Cqe.user_data]);
+               }
+               __atomic_store_n(m_pCqHead, uHead, __ATOMIC_RELEASE);
+            }
+         }
+         return true;
+      }
+
+   private:
+      static inline bool IsTransient(int iErrno) { return iErrno == EINTR || iErrno == EAGAIN || iErrno == EBUSY; }
+
+      long Enter(unsigned uToSubmit, unsigned uMinComplete)
+      {
+         const int iFailure = g_iStatxRingFailure.exchange(0);
+         if (iFailure != 0)
+         {
+            // the requests reach the kernel, then the call fails
+            syscall(__NR_io_uring_enter, m_iFd, uToSubmit, 0, 0, nullptr, 0);
+            errno = iFailure;
+            return -1;
+         }
+         return syscall(__NR_io_uring_enter, m_iFd, uToSubmit, uMinComplete, IORING_ENTER_GETEVENTS, nullptr, 0);
+      }
+
+      // reaps and discards uInFlight completions, if they can't be waited for, the buffers are
+      // leaked rather than freed while the kernel may still write into them
+      void Drain(unsigned uInFlight)
+      {
+         while (uInFlight > 0)
+         {
+            if (Enter(0, uInFlight) < 0 && !IsTransient(errno))
+            {
+               m_pBuffers.release();
+               return;
+            }
+            const unsigned uCqTail = __atomic_load_n(m_pCqTail, __ATOMIC_ACQUIRE);
+            uInFlight -= uCqTail - *m_pCqHead;
+            __atomic_store_n(m_pCqHead, uCqTail, __ATOMIC_RELEASE);
+         }
+      }
+
+      void* Map(size_t uSize, off_t lOffset)
+      {
+         void* pMapped = mmap(nullptr, uSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_iFd, lOffset);
+         return (pMapped == MAP_FAILED) ? nullptr : pMapped;
+      }
+
+      static void SetStatusFromStatx(Directory::PathStatus& Status, const struct statx& Statx)
+      {
+         Status.bExists = true;
+         Status.eType = GetEntryType(Statx.stx_mode);
+         Status.Metadata.uSize = Statx.stx_size;
+         Status.Metadata.tModificationTime = Statx.stx_mtime.tv_sec;
+         Status.Metadata.uMode = Statx.stx_mode;
+         Status.Metadata.uInode = Statx.stx_ino;
+      }
+
+      void Release()
+      {
+         if (m_pSqes)
+            munmap(m_pSqes, m_uSqesSize);
+         if (m_pCqRing && m_pCqRing != m_pSqRing)
+            munmap(m_pCqRing, m_uCqRingSize);
+         if (m_pSqRing)
+            munmap(m_pSqRing, m_uSqRingSize);
+         if (m_iFd >= 0)
+            close(m_iFd);
+         m_pSqes = nullptr;
+         m_pSqRing = m_pCqRing = nullptr;
+         m_iFd = -1;
+      }
+
+      int m_iFd = -1;
+      unsigned m_uEntries = 0;
+      size_t m_uSqRingSize = 0;
+      size_t m_uCqRingSize = 0;
+      size_t m_uSqesSize = 0;
+      void* m_pSqRing = nullptr;
+      void* m_pCqRing = nullptr;
+      struct io_uring_sqe* m_pSqes = nullptr;
+      unsigned* m_pSqHead = nullptr;
+      unsigned* m_pSqTail = nullptr;
+      unsigned* m_pSqArray = nullptr;
+      unsigned m_uSqMask = 0;
+      unsigned* m_pCqHead = nullptr;
+      unsigned* m_pCqTail = nullptr;
+      unsigned m_uCqMask = 0;
+      struct io_uring_cqe* m_pCqes = nullptr;
+      std::unique_ptr<struct statx[]> m_pBuffers;
+   };
+
+   // requests in flight at once (the completion ring holds twice as many)
+   constexpr unsigned STATX_RING_ENTRIES = 256;
+   #endif
+}
+
+void Directory::InjectStatManyFailure(const int iErrno)
+{
+   g_iStatxRingFailure = iErrno;
+}
+
+/**
+ * @brief stats many paths at once
+ *
+ * @param paths (symbolic links are followed)
+ * @param count of threads used when io_uring isn't available
+ *
+ * @return the status of each path (bExists is false if it couldn't be stat'ed)
+ */
+std::vector<Directory::PathStatus> Directory::StatMany(const std::vector<std::string>& vecPaths, const size_t uThreads)
+{
+   std::vector<PathStatus> vecStatus(vecPaths.size(), PathStatus());
+   if (vecPaths.empty())
+      return vecStatus;
+
+   #if defined(LINUX) && defined(IORING_OP_STATX) && defined(__NR_io_uring_setup)
+   {
+      StatxRing Ring(static_cast<unsigned>(std::min<size_t>(STATX_RING_ENTRIES, vecPaths.size())));
+      if (Ring.IsValid() && Ring.StatAll(vecPaths, vecStatus))
+         return vecStatus;
+      std::fill(vecStatus.begin(), vecStatus.end(), PathStatus());
+   }
+   #endif
+
+   // each worker takes the next path, blocking lookups overlap on the other threads
+   std::atomic<size_t> uNext(0);
+   RunWorkers(std::max<size_t>(1, std::min(uThreads, vecPaths.size())), [&](size_t)
+   {
+      for (size_t uIndex; (uIndex = uNext++) < vecPaths.size();)
+         SetStatus(vecStatus[uIndex], vecPaths[uIndex]);
+   });
+   return vecStatus;
+}
+
+namespace
+{
+   Directory::FolderUsage& operator+=(Directory::FolderUsage& Usage, const Directory::FolderUsage& Other)
+   {
+      Usage.uApparentSize += Other.uApparentSize;
+      Usage.uAllocatedSize += Other.uAllocatedSize;
+      Usage.uFiles += Other.uFiles;
+      Usage.uFolders += Other.uFolders;
+      return Usage;
+   }
+
+   #ifdef LINUX
+   struct UsageFolder
+   {
+      struct LinkedFile
+      {
+         dev_t Device;
+         ino_t Inode;
+         uint64_t uApparentSize;
+         uint64_t uAllocatedSize;
+      };
+
+      std::string strPath;
+      FolderHandlePtr pParent;              // until the folder is opened
+      Directory::FolderUsage Own;           // the folder itself and its files with a single link
+      std::vector<LinkedFile> vecLinkedFiles; // counted once the whole tree is read
+      std::vector<std::unique_ptr<UsageFolder>> vecSubFolders;
+   };
+
+   void AddUsage(Directory::FolderUsage& Usage, const struct stat& Stat)
+   {
+      Usage.uApparentSize += Stat.st_size;
+      Usage.uAllocatedSize += static_cast<uint64_t>(Stat.st_blocks) * 512;
+   }
+
+   // sums the subtree bottom-up, the hard links are counted the first time they are met in the
+   // depth first order (the same one whatever the count of threads)
+   Directory::FolderUsage SumUsage(UsageFolder& Folder, const size_t uKeyOffset, const size_t uDepth,
+      const Directory::DiskUsageOptions& Options, std::set<std::pair<dev_t, ino_t>>& setLinkedFiles,
+      std::vector<std::pair<std::string, Directory::FolderUsage>>& vecUsages)
+   {
+      Directory::FolderUsage Usage = Folder.Own;
+      for (const UsageFolder::LinkedFile& File : Folder.vecLinkedFiles)
+      {
+         if (!setLinkedFiles.insert(std::make_pair(File.Device, File.Inode)).second)
+            continue;
+         Usage.uApparentSize += File.uApparentSize;
+         Usage.uAllocatedSize += File.uAllocatedSize;
+         ++Usage.uFiles;
+      }
+      Folder.vecLinkedFiles.clear();
+
+      for (std::unique_ptr<UsageFolder>& pSubFolder : Folder.vecSubFolders)
+      {
+         Usage += SumUsage(*pSubFolder, uKeyOffset, uDepth + 1, Options, setLinkedFiles, vecUsages);
+         ++Usage.uFolders;
+         pSubFolder.reset();
+      }
+
+      if (uDepth > 0 && (Options.uMaxDepth == 0 || uDepth <= Options.uMaxDepth))
+         vecUsages.emplace_back(Folder.strPath.substr(uKeyOffset), Usage);
+      return Usage;
+   }
+   #endif
+}
+
+/**
+ * @brief computes the space used by a folder, recursively, and by each of its sub-folders
+ *
+ * @param path of the folder
+ * @param options : count of threads reading the folders, depth of the folders in the result
+ * @param result : total and per folder usage
+ *
+ * @return false if the folder couldn't be read
+ */
+const bool Directory::DiskUsage(const std::string& strRoot, const DiskUsageOptions& Options, DiskUsageResult& Result)
+{
+   Result = DiskUsageResult();
+   if (strRoot.empty() || !IsDirectory(strRoot))
+      return false;
+
+   // keys like the folders' relative paths of the listings
+   const std::string strLoc = fs::path(strRoot).make_preferred().string();
+   std::vector<std::pair<std::string, FolderUsage>> vecUsages; // sorted once the tree is read
+
+   #ifdef LINUX
+   int iRootFd = open(strLoc.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+   struct stat RootStat;
+   if (iRootFd < 0 || fstat(iRootFd, &RootStat) != 0)
+   {
+      if (iRootFd >= 0)
+         close(iRootFd);
+      return false;
+   }
+
+   UsageFolder Root;
+   Root.strPath = strLoc;
+   AddUsage(Root.Own, RootStat);
+
+   const size_t uThreads = std::max<size_t>(1, Options.uThreads);
+   std::atomic<size_t> uErrors(0);
+   WorkStealingQueues<UsageFolder*> Queues(uThreads);
+   Queues.Push(0, &Root);
+
+   RunWorkers(uThreads, [&](size_t uWorker)
+   {
+      std::unique_ptr<char[]> pBuffer(new char[DENTS_BUFFER_SIZE]);
+      UsageFolder* pFolder = nullptr;
+      while (Queues.Pop(uWorker, pFolder))
+      {
+         int iFd = (pFolder == &Root) ? iRootFd : OpenSubFolder(*pFolder->pParent, GetLastName(pFolder->strPath));
+         pFolder->pParent.reset();
+         if (iFd < 0)
+            ++uErrors;
+         else
+         {
+            const bool bAppendSep = (pFolder->strPath[pFolder->strPath.length() - 1] != '/');
+            ReadFolder(iFd, pBuffer.get(), [&](const char* pszName, unsigned char)
+            {
+               struct stat Stat;
+               if (fstatat(iFd, pszName, &Stat, AT_SYMLINK_NOFOLLOW) != 0)
+               {
+                  ++uErrors;
+                  return true;
+               }
+
+               if (S_ISDIR(Stat.st_mode))
+               {
+                  pFolder->vecSubFolders.emplace_back(new UsageFolder);
+                  UsageFolder& SubFolder = *pFolder->vecSubFolders.back();
+                  SubFolder.strPath = (bAppendSep) ? pFolder->strPath + '/' + pszName : pFolder->strPath + pszName;
+                  AddUsage(SubFolder.Own, Stat);
+               }
+               else if (Stat.st_nlink > 1 && !S_ISLNK(Stat.st_mode))
+               {
+                  const UsageFolder::LinkedFile File = { Stat.st_dev, Stat.st_ino, static_cast<uint64_t>(Stat.st_size),
+                                                         static_cast<uint64_t>(Stat.st_blocks) * 512 };
+                  pFolder->vecLinkedFiles.push_back(File);
+               }
+               else
+               {
+                  AddUsage(pFolder->Own, Stat);
+                  ++pFolder->Own.uFiles;
+               }
+               return true;
+            });
+            const FolderHandlePtr pHandle = std::make_shared<FolderHandle>(iFd, iFd != iRootFd);
+            for (std::unique_ptr<UsageFolder>& pSubFolder : pFolder->vecSubFolders)
+            {
+               pSubFolder->pParent = pHandle;
+               Queues.Push(uWorker, pSubFolder.get());
+            }
+         }
+         Queues.Done();
+      }
+   });
+   close(iRootFd);
+
+   std::set<std::pair<dev_t, ino_t>> setLinkedFiles;
+   Result.Total = SumUsage(Root, strLoc.length(), 0, Options, setLinkedFiles, vecUsages);
+   Result.uErrors = uErrors;
+   #else
+   // single thread : no inodes and no allocated sizes with boost, the hard links are counted each time
+   std::vector<std::pair<std::string, FolderUsage>> vecFolders; // current branch
+   auto Unwind = [&](const size_t uDepth)
+   {
+      while (vecFolders.size() > uDepth)
+      {
+         std::pair<std::string, FolderUsage> Folder = vecFolders.back();
+         vecFolders.pop_back();
+         if (vecFolders.size() + 1 <= Options.uMaxDepth || Options.uMaxDepth == 0)
+            vecUsages.emplace_back(Folder.first.substr(strLoc.length()), Folder.second);
+         FolderUsage& Parent = (vecFolders.empty()) ? Result.Total : vecFolders.back().second;
+         Parent += Folder.second;
+         ++Parent.uFolders;
+      }
+   };
+
+   boost::system::error_code ec;
+   for (fs::recursive_directory_iterator itDir(strLoc, ec), itEnd; itDir != itEnd; itDir.increment(ec))
+   {
+      if (ec)
+      {
+         ++Result.uErrors;
+         break;
+      }
+      Unwind(itDir.level());
+      const fs::file_status Status = itDir->symlink_status();
+      FolderUsage Usage;
+      if (fs::is_regular_file(Status))
+      {
+         const uintmax_t uSize = fs::file_size(itDir->path(), ec);
+         Usage.uApparentSize = Usage.uAllocatedSize = (ec) ? 0 : uSize;
+      }
+      if (fs::is_directory(Status))
+         vecFolders.push_back(std::make_pair(itDir->path().string(), Usage));
+      else
+      {
+         ++Usage.uFiles;
+         ((vecFolders.empty()) ? Result.Total : vecFolders.back().second) += Usage;
+      }
+   }
+   Unwind(0);
+   #endif
+
+   AssignSorted(Result.mapFolders, std::move(vecUsages));
+   return true;
+}
+
+const Directory::HashMap& Directory::GetMapFoldersRelAbs() const
+{
+   return GetMap(m_mapFoldersRelAbs, m_Folders, m_FoldersPaths, true, FOLDERS_REL_ABS_MAP);
+}
+
+const Directory::HashMap& Directory::GetMapFoldersAbsRel() const
+{
+   return GetMap(m_mapFoldersAbsRel, m_Folders, m_FoldersPaths, false, FOLDERS_ABS_REL_MAP);
+}
+
+const Directory::SortedMap& Directory::GetMapSortedFoldersAbsRel() const
+{
+   return GetMap(m_mapSortedFoldersAbsRel, m_Folders, m_FoldersPaths, false, SORTED_FOLDERS_ABS_REL_MAP);
+}
+
+const Directory::SortedMap& Directory::GetMapSortedFoldersRelAbs() const
+{
+   return GetMap(m_mapSortedFoldersRelAbs, m_Folders, m_FoldersPaths, true, SORTED_FOLDERS_REL_ABS_MAP);
+}
+
+const Directory::HashMap& Directory::GetMapFilesRelAbs() const
+{
+   return GetMap(m_mapFilesRelAbs, m_Files, m_FilesPaths, true, FILES_REL_ABS_MAP);
+}
+
+const Directory::HashMap& Directory::GetMapFilesAbsRel() const
+{
+   return GetMap(m_mapFilesAbsRel, m_Files, m_FilesPaths, false, FILES_ABS_REL_MAP);
+}
+
+const Directory::SortedMap& Directory::GetMapSortedFilesAbsRel() const
+{
+   return GetMap(m_mapSortedFilesAbsRel, m_Files, m_FilesPaths, false, SORTED_FILES_ABS_REL_MAP);
+}
+
+const Directory::SortedMap& Directory::GetMapSortedFilesRelAbs() const
+{
+   return GetMap(m_mapSortedFilesRelAbs, m_Files, m_FilesPaths, true, SORTED_FILES_REL_ABS_MAP);
+}
+
+const Directory::HashMapView& Directory::GetMapFoldersRelAbsView() const
+{
+   return GetMap(m_mapFoldersRelAbsView, m_Folders, m_FoldersPaths, true, FOLDERS_REL_ABS_MAP * VIEWS);
+}
+
+const Directory::HashMapView& Directory::GetMapFoldersAbsRelView() const
+{
+   return GetMap(m_mapFoldersAbsRelView, m_Folders, m_FoldersPaths, false, FOLDERS_ABS_REL_MAP * VIEWS);
+}
+
+const Directory::SortedMapView& Directory::GetMapSortedFoldersAbsRelView() const
+{
+   return GetMap(m_mapSortedFoldersAbsRelView, m_Folders, m_FoldersPaths, false, SORTED_FOLDERS_ABS_REL_MAP * VIEWS);
+}
+
+const Directory::SortedMapView& Directory::GetMapSortedFoldersRelAbsView() const
+{
+   return GetMap(m_mapSortedFoldersRelAbsView, m_Folders, m_FoldersPaths, true, SORTED_FOLDERS_REL_ABS_MAP * VIEWS);
+}
+
+const Directory::HashMapView& Directory::GetMapFilesRelAbsView() const
+{
+   return GetMap(m_mapFilesRelAbsView, m_Files, m_FilesPaths, true, FILES_REL_ABS_MAP * VIEWS);
+}
+
+const Directory::HashMapView& Directory::GetMapFilesAbsRelView() const
+{
+   return GetMap(m_mapFilesAbsRelView, m_Files, m_FilesPaths, false, FILES_ABS_REL_MAP * VIEWS);
+}
+
+const Directory::SortedMapView& Directory::GetMapSortedFilesAbsRelView() const
+{
+   return GetMap(m_mapSortedFilesAbsRelView, m_Files, m_FilesPaths, false, SORTED_FILES_ABS_REL_MAP * VIEWS);
+}
+
+const Directory::SortedMapView& Directory::GetMapSortedFilesRelAbsView() const
+{
+   return GetMap(m_mapSortedFilesRelAbsView, m_Files, m_FilesPaths, true, SORTED_FILES_REL_ABS_MAP * VIEWS);
+}
+
+namespace
+{
+   // estimate : a node (pair and links) per entry, the strings' buffers unless they are short ones, the buckets
+   template <typename Map>
+   size_t GetMapMemoryUsage(const Map& mapPaths)
+   {
+      const size_t uShortCapacity = std::string().capacity();
+      size_t uBytes = mapPaths.size() * (sizeof(typename Map::value_type) + 3 * sizeof(void*));
+      for (const auto& Pair : mapPaths)
+      {
+         uBytes += (Pair.first.capacity() > uShortCapacity) ? Pair.first.capacity() + 1 : 0;
+         uBytes += (Pair.second.capacity() > uShortCapacity) ? Pair.second.capacity() + 1 : 0;
+      }
+      return uBytes;
+   }
+
+   size_t GetMapMemoryUsage(const Directory::HashMap& mapPaths)
+   {
+      return GetMapMemoryUsage<Directory::HashMap>(mapPaths) + mapPaths.bucket_count() * sizeof(void*);
+   }
+}
+
+const Directory::Statistics Directory::Stats() const
+{
+   std::lock_guard<std::mutex> Lock(m_BuiltMaps.Mutex); // maps being built by another thread
+   Statistics Result = m_Times;
+   Result.uFolders = m_Folders.Size();
+   Result.uFiles = m_Files.Size();
+
+   Result.uFoldersTableBytes = m_Folders.GetMemoryUsage();
+   Result.uFilesTableBytes = m_Files.GetMemoryUsage();
+   Result.uMetadataBytes = m_FoldersMetadata.GetMemoryUsage() + m_FilesMetadata.GetMemoryUsage();
+   Result.uHashMapsBytes = GetMapMemoryUsage(m_mapFoldersRelAbs) + GetMapMemoryUsage(m_mapFoldersAbsRel)
+      + GetMapMemoryUsage(m_mapFilesRelAbs) + GetMapMemoryUsage(m_mapFilesAbsRel)
+      + m_mapFoldersRelAbsView.GetMemoryUsage() + m_mapFoldersAbsRelView.GetMemoryUsage()
+      + m_mapFilesRelAbsView.GetMemoryUsage() + m_mapFilesAbsRelView.GetMemoryUsage();
+   Result.uSortedMapsBytes = GetMapMemoryUsage(m_mapSortedFoldersRelAbs) + GetMapMemoryUsage(m_mapSortedFoldersAbsRel)
+      + GetMapMemoryUsage(m_mapSortedFilesRelAbs) + GetMapMemoryUsage(m_mapSortedFilesAbsRel)
+      + m_mapSortedFoldersRelAbsView.GetMemoryUsage() + m_mapSortedFoldersAbsRelView.GetMemoryUsage()
+      + m_mapSortedFilesRelAbsView.GetMemoryUsage() + m_mapSortedFilesAbsRelView.GetMemoryUsage();
+   Result.uAbsolutePathsBytes = m_FoldersPaths.Arena.GetCapacity() + m_FilesPaths.Arena.GetCapacity()
+      + (m_FoldersPaths.vecPaths.capacity() + m_FilesPaths.vecPaths.capacity()) * sizeof(PooledString);
+   Result.uTotalBytes = Result.uFoldersTableBytes + Result.uFilesTableBytes + Result.uMetadataBytes
+      + Result.uHashMapsBytes + Result.uSortedMapsBytes + Result.uAbsolutePathsBytes;
+   return Result;
+}
+
+std::string Directory::Statistics::ToPrometheus(const std::string& strPrefix, const std::string& strLabels) const
+{
+   std::ostringstream ssOut;
+   ssOut << std::fixed << std::setprecision(9); // seconds, integers aren't affected
+   const std::string strExtraLabels = (strLabels.empty()) ? "" : "," + strLabels;
+   auto Header = [&](const char* pszName, const char* pszHelp)
+   {
+      ssOut << "# HELP " << strPrefix << '_' << pszName << ' ' << pszHelp << '\n'
+            << "# TYPE " << strPrefix << '_' << pszName << " gauge\n";
+   };
+   // the value follows the returned stream
+   auto Sample = [&](const char* pszName, const char* pszLabel, const char* pszValue) -> std::ostringstream&
+   {
+      ssOut << strPrefix << '_' << pszName << '{' << pszLabel << "=\"" << pszValue << '"' << strExtraLabels << "} ";
+      return ssOut;
+   };
+
+   Header("entries", "Number of listed entries.");
+   Sample("entries", "type", "folder") << uFolders << '\n';
+   Sample("entries", "type", "file") << uFiles << '\n';
+
+   Header("memory_bytes", "Bytes allocated by the listing, its indexes and string pools.");
+   Sample("memory_bytes", "part", "folders_table") << uFoldersTableBytes << '\n';
+   Sample("memory_bytes", "part", "files_table") << uFilesTableBytes << '\n';
+   Sample("memory_bytes", "part", "metadata") << uMetadataBytes << '\n';
+   Sample("memory_bytes", "part", "hash_maps") << uHashMapsBytes << '\n';
+   Sample("memory_bytes", "part", "sorted_maps") << uSortedMapsBytes << '\n';
+   Sample("memory_bytes", "part", "absolute_paths") << uAbsolutePathsBytes << '\n';
+   Sample("memory_bytes", "part", "total") << uTotalBytes << '\n';
+
+   Header("time_seconds", "Time spent by the last listing and by building its maps.");
+   Sample("time_seconds", "phase", "listing") << uListingNanoseconds / 1e9 << '\n';
+   Sample("time_seconds", "phase", "readdir") << uReadDirNanoseconds / 1e9 << '\n';
+   Sample("time_seconds", "phase", "stat") << uStatNanoseconds / 1e9 << '\n';
+   Sample("time_seconds", "phase", "sort") << uSortNanoseconds / 1e9 << '\n';
+   Sample("time_seconds", "phase", "map_build") << uMapBuildNanoseconds / 1e9 << '\n';
+
+   Header("errors", "Errors ignored by the last listing (unreadable folders, failed stat calls).");
+   ssOut << strPrefix << "_errors";
+   if (!strLabels.empty())
+      ssOut << '{' << strLabels << '}';
+   ssOut << ' ' << uErrors << '\n';
+   return ssOut.str();
+}
+
+Directory::WalkStats& Directory::WalkStats::operator+=(const WalkStats& Other)
+{
+   uReadDirNanoseconds += Other.uReadDirNanoseconds;
+   uStatNanoseconds += Other.uStatNanoseconds;
+   uErrors += Other.uErrors;
+   return *this;
+}
+
+std::string Directory::EntryTable::GetAbsolutePath(const size_t uIndex) const
+{
+   std::string strAbsolutePath;
+   GetAbsolutePath(uIndex, strAbsolutePath);
+   return strAbsolutePath;
+}
+
+void Directory::EntryTable::GetAbsolutePath(const size_t uIndex, std::string& strAbsolutePath) const
+{
+   strAbsolutePath.assign(m_strRoot);
+   strAbsolutePath.append(GetRelativePath(uIndex), GetRelativePathLength(uIndex));
+
+   #ifdef STD_RELATIVE_PATH
+   // relative paths were standardized with '/', the listed paths used the Windows separator
+   std::replace(strAbsolutePath.begin() + m_strRoot.length(), strAbsolutePath.end(), '/', '\\');
+   #endif
+}
+
+const size_t Directory::EntryTable::GetMemoryUsage() const
+{
+   return m_strRoot.capacity() + m_strPool.capacity() + m_vecOffsets.capacity() * sizeof(size_t);
+}
+
+void Directory::EntryTable::Clear()
+{
+   // capacities are kept for the next listing
+   m_strRoot.clear();
+   m_strPool.clear();
+   m_vecOffsets.clear();
+}
+
+void Directory::EntryTable::Add(const std::string& strAbsolutePath, const std::string& strRelativePath)
+{
+   // the root is the common prefix, the relative paths of folders and files don't start at the same position
+   if (m_vecOffsets.empty())
+      m_strRoot.assign(strAbsolutePath, 0, strAbsolutePath.length() - strRelativePath.length());
+
+   m_vecOffsets.push_back(m_strPool.size());
+   m_strPool.append(strRelativePath);
+   m_strPool.push_back('\0');
+}
+
+const uint64_t Directory::MetadataTable::GetTotalSize() const
+{
+   return std::accumulate(m_vecSizes.begin(), m_vecSizes.end(), uint64_t(0));
+}
+
+const size_t Directory::MetadataTable::GetMemoryUsage() const
+{
+   return m_vecSizes.capacity() * sizeof(uint64_t) + m_vecModificationTimes.capacity() * sizeof(std::time_t)
+      + m_vecModes.capacity() * sizeof(uint32_t) + m_vecInodes.capacity() * sizeof(uint64_t);
+}
+
+void Directory::MetadataTable::Clear()
+{
+   m_vecSizes.clear();
+   m_vecModificationTimes.clear();
+   m_vecModes.clear();
+   m_vecInodes.clear();
+}
+
+void Directory::MetadataTable::Add(const EntryMetadata& Metadata)
+{
+   m_vecSizes.push_back(Metadata.uSize);
+   m_vecModificationTimes.push_back(Metadata.tModificationTime);
+   m_vecModes.push_back(Metadata.uMode);
+   m_vecInodes.push_back(Metadata.uInode);
+}
+
+// Indexes
+
+/* layout of an index file : the header, the string pool then 8 bytes aligned arrays */
+struct DirectoryIndex::Table
+{
+   uint64_t uRoot;   // pool offset of the root
+   uint64_t uCount;
+   uint64_t uPaths;  // uint64_t[uCount] : pool offsets of the relative paths
+   uint64_t uSorted; // uint64_t[uCount] : indexes of the entries sorted by relative path (strcmp)
+   uint64_t uSizes;  // uint64_t[uCount] if INDEX_METADATA
+   uint64_t uTimes;  // int64_t[uCount] if INDEX_METADATA
+};
+
+struct DirectoryIndex::Header
+{
+   char szMagic[8];
+   uint32_t uVersion;
+   uint32_t uFlags;
+   uint64_t uFileSize;
+   uint64_t uPool;
+   uint64_t uPoolSize;
+   uint64_t uLocation;      // pool offset of the listed directory
+   Table Folders;
+   Table Files;
+   uint64_t uFoldersTimes;  // FolderTime[uFoldersTimesCount] sorted by path (strcmp)
+   uint64_t uFoldersTimesCount;
+};
+
+namespace
+{
+   constexpr char INDEX_MAGIC[8] = { 'L', 'R', 'E', 'P', 'I', 'D', 'X', '\0' };
+   constexpr uint32_t INDEX_VERSION = 1;
+
+   enum IndexFlags
+   {
+      INDEX_RECURSIVE = 1 << 0,
+      INDEX_METADATA  = 1 << 1
+   };
+
+   struct FolderTime
+   {
+      uint64_t uPath; // pool offset of the absolute path (without trailing separator)
+      int64_t iSeconds;
+      int64_t iNanoseconds;
+   };
+
+   bool GetFolderTime(const std::string& strPath, int64_t& iSeconds, int64_t& iNanoseconds)
+   {
+      #ifdef LINUX
+      struct stat Stat;
+      if (stat(strPath.c_str(), &Stat) != 0 || !S_ISDIR(Stat.st_mode))
+         return false;
+      iSeconds = Stat.st_mtim.tv_sec;
+      iNanoseconds = Stat.st_mtim.tv_nsec;
+      #else
+      boost::system::error_code ec;
+      if (!fs::is_directory(strPath, ec))
+         return false;
+      iSeconds = fs::last_write_time(strPath, ec);
+      iNanoseconds = 0;
+      #endif
+      return true;
+   }
+
+   std::string WithoutTrailingSeparator(const std::string& strPath)
+   {
+      if (strPath.length() > 1 && (strPath[strPath.length() - 1] == '/' || strPath[strPath.length() - 1] == '\\'))
+         return strPath.substr(0, strPath.length() - 1);
+      return strPath;
+   }
+
+   // appends the array to the buffer (8 bytes aligned), returns its offset
+   template <typename T>
+   uint64_t AppendArray(std::string& strBuffer, const std::vector<T>& vecData)
+   {
+      strBuffer.resize((strBuffer.size() + 7) & ~size_t(7), '\0');
+      const uint64_t uOffset = strBuffer.size();
+      strBuffer.append(reinterpret_cast<const char*>(vecData.data()), vecData.size() * sizeof(T));
+      return uOffset;
+   }
+}
+
+/**
+ * @brief saves the last listing to an index file
+ *
+ * The folders' mtimes are read now : save the index right after the listing so that changes made
+ * in between are detected by DirectoryIndex::Validate. Without listed folders, a recursive listing's
+ * folders are walked to get them.
+ *
+ * @param path of the index file (written to a temporary file, then renamed)
+ *
+ * @return false if nothing was listed or if the file couldn't be written
+ */
+const bool Directory::SaveIndex(const std::string& strIndexFile) const
+{
+   if (m_strLocation.empty())
+      return false;
+
+   DirectoryIndex::Header IndexHeader;
+   memset(&IndexHeader, 0, sizeof(IndexHeader));
+   memcpy(IndexHeader.szMagic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+   IndexHeader.uVersion = INDEX_VERSION;
+
+   // the string pool
+   std::string strPool;
+   auto AddString = [&strPool](const std::string& strValue)
+   {
+      const uint64_t uOffset = strPool.size();
+      strPool.append(strValue);
+      strPool.push_back('\0');
+      return uOffset;
+   };
+   IndexHeader.uLocation = AddString(m_strLocation);
+
+   // the tables' pools are copied as they are, only their offsets are shifted
+   auto AddTable = [&](DirectoryIndex::Table& IndexTable, const EntryTable& Table, std::vector<uint64_t>& vecPaths)
+   {
+      IndexTable.uRoot = AddString(Table.GetRoot());
+      IndexTable.uCount = Table.Size();
+      if (Table.Size() == 0)
+         return;
+      const uint64_t uBase = strPool.size();
+      const char* pszPool = Table.GetRelativePath(0);
+      strPool.append(pszPool, Table.GetPoolSize());
+      vecPaths.reserve(Table.Size());
+      for (size_t uIndex = 0; uIndex < Table.Size(); ++uIndex)
+         vecPaths.push_back(uBase + (Table.GetRelativePath(uIndex) - pszPool));
+   };
+   std::vector<uint64_t> vecFoldersPaths, vecFilesPaths;
+   AddTable(IndexHeader.Folders, m_Folders, vecFoldersPaths);
+   AddTable(IndexHeader.Files, m_Files, vecFilesPaths);
+
+   // the folders whose mtime tells if the listing is still valid
+   std::vector<std::string> vecFolders(1, WithoutTrailingSeparator(m_strLocation));
+   if (m_bRecursive && m_Folders.Size() == 0)
+   {
+      WalkOptions Options;
+      Options.Filter = m_Filter;
+      Walk(m_strLocation, Options, [&vecFolders](const WalkEntry& Entry)
+      {
+         if (Entry.eType == FOLDER_ENTRY)
+            vecFolders.push_back(Entry.strAbsolutePath);
+         return true;
+      });
+   }
+   else if (m_bRecursive)
+   {
+      for (size_t uIndex = 0; uIndex < m_Folders.Size(); ++uIndex)
+         vecFolders.push_back(WithoutTrailingSeparator(m_Folders.GetAbsolutePath(uIndex)));
+   }
+   std::sort(vecFolders.begin(), vecFolders.end());
+   vecFolders.erase(std::unique(vecFolders.begin(), vecFolders.end()), vecFolders.end());
+
+   std::vector<FolderTime> vecFoldersTimes;
+   vecFoldersTimes.reserve(vecFolders.size());
+   for (const std::string& strFolder : vecFolders)
+   {
+      FolderTime Time = { 0, 0, 0 };
+      if (!GetFolderTime(strFolder, Time.iSeconds, Time.iNanoseconds))
+         continue; // already removed : its parent's mtime changed
+      Time.uPath = AddString(strFolder);
+      vecFoldersTimes.push_back(Time);
+   }
+
+   std::string strData(sizeof(DirectoryIndex::Header), '\0');
+   IndexHeader.uPool = strData.size();
+   IndexHeader.uPoolSize = strPool.size();
+   strData.append(strPool);
+   strPool.clear();
+
+   auto AddSortedIndexes = [&](DirectoryIndex::Table& IndexTable, const std::vector<uint64_t>& vecPaths)
+   {
+      std::vector<uint64_t> vecSorted(vecPaths.size());
+      std::iota(vecSorted.begin(), vecSorted.end(), uint64_t(0));
+      const char* pszPool = strData.data() + IndexHeader.uPool;
+      std::sort(vecSorted.begin(), vecSorted.end(), [&](const uint64_t uA, const uint64_t uB)
+      {
+         return strcmp(pszPool + vecPaths[uA], pszPool + vecPaths[uB]) < 0;
+      });
+      IndexTable.uPaths = AppendArray(strData, vecPaths);
+      IndexTable.uSorted = AppendArray(strData, vecSorted);
+   };
+   AddSortedIndexes(IndexHeader.Folders, vecFoldersPaths);
+   AddSortedIndexes(IndexHeader.Files, vecFilesPaths);
+
+   auto AddMetadata = [&](DirectoryIndex::Table& IndexTable, const MetadataTable& Metadata)
+   {
+      const std::vector<std::time_t>& vecTimes = Metadata.GetModificationTimes();
+      IndexTable.uSizes = AppendArray(strData, Metadata.GetSizes());
+      IndexTable.uTimes = AppendArray(strData, std::vector<int64_t>(vecTimes.begin(), vecTimes.end()));
+   };
+   if (m_FilesMetadata.Size() == m_Files.Size() && m_FoldersMetadata.Size() == m_Folders.Size()
+      && m_FilesMetadata.Size() + m_FoldersMetadata.Size() > 0)
+   {
+      IndexHeader.uFlags |= INDEX_METADATA;
+      AddMetadata(IndexHeader.Folders, m_FoldersMetadata);
+      AddMetadata(IndexHeader.Files, m_FilesMetadata);
+   }
+   if (m_bRecursive)
+      IndexHeader.uFlags |= INDEX_RECURSIVE;
+
+   IndexHeader.uFoldersTimes = AppendArray(strData, vecFoldersTimes);
+   IndexHeader.uFoldersTimesCount = vecFoldersTimes.size();
+   IndexHeader.uFileSize = strData.size();
+   memcpy(&strData[0], &IndexHeader, sizeof(IndexHeader));
+
+   // readers never see a partially written index
+   const std::string strTemporaryFile = strIndexFile + ".tmp";
+   {
+      std::ofstream ofsIndex(strTemporaryFile, std::ofstream::binary | std::ofstream::trunc);
+      if (!ofsIndex.write(strData.data(), strData.size()))
+      {
+         std::cerr << "[ERROR][Directory::SaveIndex] File '" << strTemporaryFile << "' could not be written." << std::endl;
+         return false;
+      }
+   }
+   return Rename(strTemporaryFile, strIndexFile);
+}
+
+const bool Directory::LoadIndex(const DirectoryIndex& Index)
+{
+   ClearFolders();
+   ClearFiles();
+   m_Times = Statistics();
+   m_strLocation.clear();
+   if (!Index.IsOpen())
+      return false;
+
+   const std::string strFoldersRoot(Index.GetFoldersRoot());
+   for (size_t uIndex = 0; uIndex < Index.GetFoldersCount(); ++uIndex)
+   {
+      const char* pszRelativePath = Index.GetFolderRelativePath(uIndex);
+      m_Folders.Add(strFoldersRoot + pszRelativePath, pszRelativePath);
+      if (Index.HasMetadata())
+         m_FoldersMetadata.Add({ Index.GetFolderSize(uIndex), Index.GetFolderModificationTime(uIndex), 0, 0 });
+   }
+   const std::string strFilesRoot(Index.GetFilesRoot());
+   for (size_t uIndex = 0; uIndex < Index.GetFilesCount(); ++uIndex)
+   {
+      const char* pszRelativePath = Index.GetFileRelativePath(uIndex);
+      m_Files.Add(strFilesRoot + pszRelativePath, pszRelativePath);
+      if (Index.HasMetadata())
+         m_FilesMetadata.Add({ Index.GetFileSize(uIndex), Index.GetFileModificationTime(uIndex), 0, 0 });
+   }
+
+   m_strLocation = Index.GetLocation();
+   m_bRecursive = Index.IsRecursive();
+   return true;
+}
+
+DirectoryIndex::~DirectoryIndex()
+{
+   Close();
+}
+
+/**
+ * @brief maps an index file saved by Directory::SaveIndex
+ *
+ * The header is checked (format, version and sections inside the file), then the offsets and indexes
+ * stored in the arrays (in the string pool, among the entries) : a truncated or corrupted file is rejected
+ * rather than read out of bounds later. The strings aren't read, the pool ends with a '\0'.
+ *
+ * @return false if the file couldn't be mapped or isn't an index
+ */
+const bool DirectoryIndex::Open(const std::string& strIndexFile)
+{
+   Close();
+
+   #ifdef LINUX
+   int iFd = open(strIndexFile.c_str(), O_RDONLY | O_CLOEXEC);
+   if (iFd < 0)
+      return false;
+   struct stat Stat;
+   if (fstat(iFd, &Stat) != 0 || static_cast<size_t>(Stat.st_size) < sizeof(Header))
+   {
+      close(iFd);
+      return false;
+   }
+   void* pMapped = mmap(nullptr, Stat.st_size, PROT_READ, MAP_PRIVATE, iFd, 0);
+   close(iFd);
+   if (pMapped == MAP_FAILED)
+      return false;
+   m_pData = static_cast<const char*>(pMapped);
+   m_uSize = Stat.st_size;
+   #else
+   try
+   {
+      m_File = boost::interprocess::file_mapping(strIndexFile.c_str(), boost::interprocess::read_only);
+      m_Region = boost::interprocess::mapped_region(m_File, boost::interprocess::read_only);
+   }
+   catch (const boost::interprocess::interprocess_exception& ex)
+   {
+      std::cout << ex.what() << std::endl;
+      return false;
+   }
+   m_pData = static_cast<const char*>(m_Region.get_address());
+   m_uSize = m_Region.get_size();
+   #endif
+
+   const Header* pHeader = At<Header>(0);
+   // the arrays are 8 bytes aligned
+   auto InFile = [this](const uint64_t uOffset, const uint64_t uCount, const size_t uItemSize)
+   {
+      return uOffset <= m_uSize && uCount <= (m_uSize - uOffset) / uItemSize && (uItemSize == 1 || uOffset % 8 == 0);
+   };
+   auto TableInFile = [&](const Table& IndexTable, const bool bMetadata)
+   {
+      return IndexTable.uRoot < pHeader->uPoolSize
+         && InFile(IndexTable.uPaths, IndexTable.uCount, sizeof(uint64_t))
+         && InFile(IndexTable.uSorted, IndexTable.uCount, sizeof(uint64_t))
+         && (!bMetadata || (InFile(IndexTable.uSizes, IndexTable.uCount, sizeof(uint64_t))
+                            && InFile(IndexTable.uTimes, IndexTable.uCount, sizeof(int64_t))));
+   };
+
+   // the arrays are in the file : their items must point into the pool (paths) or the table (sorted indexes)
+   auto EntriesInRange = [&](const Table& IndexTable)
+   {
+      const uint64_t* pPaths = At<uint64_t>(IndexTable.uPaths);
+      const uint64_t* pSorted = At<uint64_t>(IndexTable.uSorted);
+      for (uint64_t uIndex = 0; uIndex < IndexTable.uCount; ++uIndex)
+         if (pPaths[uIndex] >= pHeader->uPoolSize || pSorted[uIndex] >= IndexTable.uCount)
+            return false;
+      return true;
+   };
+   auto FoldersTimesInRange = [&]()
+   {
+      const FolderTime* pTimes = At<FolderTime>(pHeader->uFoldersTimes);
+      for (uint64_t uIndex = 0; uIndex < pHeader->uFoldersTimesCount; ++uIndex)
+         if (pTimes[uIndex].uPath >= pHeader->uPoolSize)
+            return false;
+      return true;
+   };
+
+   m_pHeader = pHeader; // for Close()
+   if (m_uSize < sizeof(Header) || memcmp(pHeader->szMagic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0
+      || pHeader->uVersion != INDEX_VERSION || pHeader->uFileSize != m_uSize
+      || !InFile(pHeader->uPool, pHeader->uPoolSize, 1) || pHeader->uPoolSize == 0
+      || m_pData[pHeader->uPool + pHeader->uPoolSize - 1] != '\0' || pHeader->uLocation >= pHeader->uPoolSize
+      || !TableInFile(pHeader->Folders, HasMetadata()) || !TableInFile(pHeader->Files, HasMetadata())
+      || !InFile(pHeader->uFoldersTimes, pHeader->uFoldersTimesCount, sizeof(FolderTime))
+      || !EntriesInRange(pHeader->Folders) || !EntriesInRange(pHeader->Files) || !FoldersTimesInRange())
+   {
+      std::cerr << "[ERROR][DirectoryIndex::Open] File '" << strIndexFile << "' is not a valid index." << std::endl;
+      Close();
+      return false;
+   }
+   return true;
+}
+
+void DirectoryIndex::Close()
+{
+   #ifdef LINUX
+   if (m_pData)
+      munmap(const_cast<char*>(m_pData), m_uSize);
+   #else
+   m_Region = boost::interprocess::mapped_region();
+   m_File = boost::interprocess::file_mapping();
+   #endif
+   m_pData = nullptr;
+   m_uSize = 0;
+   m_pHeader = nullptr;
+}
+
+const char* DirectoryIndex::GetLocation() const
+{
+   return At<char>(m_pHeader->uPool + m_pHeader->uLocation);
+}
+
+const bool DirectoryIndex::IsRecursive() const
+{
+   return (m_pHeader->uFlags & INDEX_RECURSIVE) != 0;
+}
+
+const size_t DirectoryIndex::GetFoldersCount() const
+{
+   return (m_pHeader) ? m_pHeader->Folders.uCount : 0;
+}
+
+const size_t DirectoryIndex::GetFilesCount() const
+{
+   return (m_pHeader) ? m_pHeader->Files.uCount : 0;
+}
+
+const DirectoryIndex::Table& DirectoryIndex::GetTable(const bool bFolders) const
+{
+   return (bFolders) ? m_pHeader->Folders : m_pHeader->Files;
+}
+
+const char* DirectoryIndex::GetFoldersRoot() const
+{
+   return At<char>(m_pHeader->uPool + m_pHeader->Folders.uRoot);
+}
+
+const char* DirectoryIndex::GetFilesRoot() const
+{
+   return At<char>(m_pHeader->uPool + m_pHeader->Files.uRoot);
+}
+
+const char* DirectoryIndex::GetRelativePath(const Table& IndexTable, const size_t uIndex) const
+{
+   return At<char>(m_pHeader->uPool + At<uint64_t>(IndexTable.uPaths)[uIndex]);
+}
+
+const char* DirectoryIndex::GetFolderRelativePath(const size_t uIndex) const
+{
+   return GetRelativePath(GetTable(true), uIndex);
+}
+
+const char* DirectoryIndex::GetFileRelativePath(const size_t uIndex) const
+{
+   return GetRelativePath(GetTable(false), uIndex);
+}
+
+const bool DirectoryIndex::HasMetadata() const
+{
+   return (m_pHeader->uFlags & INDEX_METADATA) != 0;
+}
+
+const uint64_t DirectoryIndex::GetFolderSize(const size_t uIndex) const
+{
+   return At<uint64_t>(m_pHeader->Folders.uSizes)[uIndex];
+}
+
+const std::time_t DirectoryIndex::GetFolderModificationTime(const size_t uIndex) const
+{
+   return static_cast<std::time_t>(At<int64_t>(m_pHeader->Folders.uTimes)[uIndex]);
+}
+
+const uint64_t DirectoryIndex::GetFileSize(const size_t uIndex) const
+{
+   return At<uint64_t>(m_pHeader->Files.uSizes)[uIndex];
+}
+
+const std::time_t DirectoryIndex::GetFileModificationTime(const size_t uIndex) const
+{
+   return static_cast<std::time_t>(At<int64_t>(m_pHeader->Files.uTimes)[uIndex]);
+}
+
+const bool DirectoryIndex::Find(const Table& IndexTable, const std::string& strRelativePath, size_t& uIndex) const
+{
+   const uint64_t* pSorted = At<uint64_t>(IndexTable.uSorted);
+   const uint64_t* pEnd = pSorted + IndexTable.uCount;
+   const uint64_t* pFound = std::lower_bound(pSorted, pEnd, strRelativePath.c_str(),
+      [&](const uint64_t uEntry, const char* pszPath) { return strcmp(GetRelativePath(IndexTable, uEntry), pszPath) < 0; });
+   if (pFound == pEnd || strRelativePath != GetRelativePath(IndexTable, *pFound))
+      return false;
+   uIndex = *pFound;
+   return true;
+}
+
+const bool DirectoryIndex::FindFolder(const std::string& strRelativePath, size_t& uIndex) const
+{
+   return IsOpen() && Find(GetTable(true), strRelativePath, uIndex);
+}
+
+const bool DirectoryIndex::FindFile(const std::string& strRelativePath, size_t& uIndex) const
+{
+   return IsOpen() && Find(GetTable(false), strRelativePath, uIndex);
+}
+
+const bool DirectoryIndex::ValidateRange(const size_t uBegin, const size_t uEnd) const
+{
+   const FolderTime* pTimes = At<FolderTime>(m_pHeader->uFoldersTimes);
+   for (size_t uIndex = uBegin; uIndex < uEnd; ++uIndex)
+   {
+      int64_t iSeconds, iNanoseconds;
+      if (!GetFolderTime(At<char>(m_pHeader->uPool + pTimes[uIndex].uPath), iSeconds, iNanoseconds)
+         || iSeconds != pTimes[uIndex].iSeconds || iNanoseconds != pTimes[uIndex].iNanoseconds)
+         return false;
+   }
+   return true;
+}
+
+const bool DirectoryIndex::Validate() const
+{
+   return IsOpen() && ValidateRange(0, m_pHeader->uFoldersTimesCount);
+}
+
+const bool DirectoryIndex::ValidateFolder(const std::string& strAbsolutePath) const
+{
+   if (!IsOpen())
+      return false;
+
+   // the folder then its subtree [folder/, folder0) ('0' follows '/')
+   const FolderTime* pTimes = At<FolderTime>(m_pHeader->uFoldersTimes);
+   const FolderTime* pEnd = pTimes + m_pHeader->uFoldersTimesCount;
+   auto LowerBound = [&](const std::string& strPath)
+   {
+      return std::lower_bound(pTimes, pEnd, strPath.c_str(), [&](const FolderTime& Time, const char* pszPath)
+      {
+         return strcmp(At<char>(m_pHeader->uPool + Time.uPath), pszPath) < 0;
+      }) - pTimes;
+   };
+   const std::string strFolder = WithoutTrailingSeparator(strAbsolutePath);
+   const size_t uFolder = LowerBound(strFolder);
+   const size_t uSubtreeBegin = LowerBound(strFolder + '/');
+   const size_t uSubtreeEnd = LowerBound(strFolder + '0');
+   if (uFolder < m_pHeader->uFoldersTimesCount && strFolder == At<char>(m_pHeader->uPool + pTimes[uFolder].uPath)
+      && !ValidateRange(uFolder, uFolder + 1))
+      return false;
+   return ValidateRange(uSubtreeBegin, uSubtreeEnd);
+}
+
+// Throttle
+
+IoThrottle& IoThrottle::GetInstance()
+{
+   static IoThrottle Throttle;
+   return Throttle;
+}
+
+IoThrottle::IoThrottle() :
+   m_dOpsRate(0),
+   m_dBytesRate(0),
+   m_dOpsTokens(0),
+   m_dBytesTokens(0),
+   m_tLastRefill(std::chrono::steady_clock::now()),
+   m_bLimited(false),
+   m_bLimitsBytes(false),
+   m_bIdlePriority(false),
+   m_uThrottledNanoseconds(0),
+   m_uThrottledCount(0)
+{
+}
+
+/**
+ * @brief sets the rates of the removals, the buckets start full
+ *
+ * @param removals per second, 0 for no limit
+ * @param bytes of deleted files per second, 0 for no limit
+ */
+void IoThrottle::SetLimits(const uint64_t uOpsPerSecond, const uint64_t uBytesPerSecond)
+{
+   std::lock_guard<std::mutex> Lock(m_Mutex);
+   m_dOpsRate = static_cast<double>(uOpsPerSecond);
+   m_dBytesRate = static_cast<double>(uBytesPerSecond);
+   m_dOpsTokens = m_dOpsRate;
+   m_dBytesTokens = m_dBytesRate;
+   m_tLastRefill = std::chrono::steady_clock::now();
+   m_bLimitsBytes.store(uBytesPerSecond != 0);
+   m_bLimited.store(uOpsPerSecond != 0 || uBytesPerSecond != 0);
+}
+
+// the tokens are taken at once, even beyond the bucket's content : the debt makes the next callers
+// wait too, so that the threads removing entries together share the rates
+void IoThrottle::Acquire(const uint64_t uOps, const uint64_t uBytes)
+{
+   if (!m_bLimited.load())
+      return;
+
+   double dWaitSeconds = 0;
+   {
+      std::lock_guard<std::mutex> Lock(m_Mutex);
+      const std::chrono::steady_clock::time_point tNow = std::chrono::steady_clock::now();
+      const double dElapsed = std::chrono::duration<double>(tNow - m_tLastRefill).count();
+      m_tLastRefill = tNow;
+      if (m_dOpsRate > 0)
+      {
+         m_dOpsTokens = std::min(m_dOpsRate, m_dOpsTokens + dElapsed * m_dOpsRate) - uOps;
+         dWaitSeconds = std::max(dWaitSeconds, -m_dOpsTokens / m_dOpsRate);
+      }
+      if (m_dBytesRate > 0)
+      {
+         m_dBytesTokens = std::min(m_dBytesRate, m_dBytesTokens + dElapsed * m_dBytesRate) - uBytes;
+         dWaitSeconds = std::max(dWaitSeconds, -m_dBytesTokens / m_dBytesRate);
+      }
+   }
+
+   if (dWaitSeconds > 0)
+   {
+      uint64_t uNanoseconds = 0;
+      {
+         ScopedTimer Timer(&uNanoseconds);
+         std::this_thread::sleep_for(std::chrono::duration<double>(dWaitSeconds));
+      }
+      m_uThrottledNanoseconds += uNanoseconds;
+      ++m_uThrottledCount;
+   }
+}
+
+void IoThrottle::ResetCounters()
+{
+   m_uThrottledNanoseconds.store(0);
+   m_uThrottledCount.store(0);
+}
+
+// Reaper
+
+const char* const FolderReaper::TRASH_NAME = ".localrep_trash";
+
+namespace
+{
+   // the names in the trashes are <process id>_<counter> : a process leaves the entries of the
+   // running processes to them (under Linux, elsewhere it's an id of the current process only)
+   const std::string& GetProcessId()
+   {
+      #ifdef LINUX
+      static const std::string strId = std::to_string(getpid());
+      #else
+      static const std::string strId = std::to_string(std::chrono::system_clock::now().time_since_epoch().count());
+      #endif
+      return strId;
+   }
+
+   bool IsLeftover(const std::string& strName)
+   {
+      const std::string strId = strName.substr(0, strName.find('_'));
+      if (strId == GetProcessId())
+         return false;
+      #ifdef LINUX
+      const long lPid = strtol(strId.c_str(), nullptr, 10);
+      if (lPid > 0 && (kill(static_cast<pid_t>(lPid), 0) == 0 || errno == EPERM))
+         return false;
+      #endif
+      return true;
+   }
+
+   // removes a trashed entry, the removal stops once bStop is set
+   size_t RemoveTrashed(const std::string& strPath, size_t uThreads, const std::atomic<bool>& bStop)
+   {
+      #ifdef LINUX
+      struct stat Stat;
+      if (lstat(strPath.c_str(), &Stat) != 0)
+         return 0; // already removed (leftover collected twice)
+      if (!S_ISDIR(Stat.st_mode))
+         return (unlink(strPath.c_str()) == 0) ? 1 : 0;
+
+      ParallelRemover Remover(uThreads, &bStop);
+      if (!Remover.Remove(strPath) && !bStop.load())
+         std::cout << "[ERROR][FolderReaper] '" << Remover.GetFailedPath() << "' could not be removed : "
+                   << strerror(errno) << std::endl;
+      return Remover.GetRemovedCount();
+      #else
+      bool bSuccess = false;
+      return Directory::EraseFolder(strPath, bSuccess, uThreads);
+      #endif
+   }
+}
+
+FolderReaper& FolderReaper::GetInstance()
+{
+   static FolderReaper Reaper;
+   return Reaper;
+}
+
+FolderReaper::FolderReaper() :
+   m_bStop(false),
+   m_uBusy(0),
+   m_uThreads(1),
+   m_uCounter(0),
+   m_uRemoved(0)
+{
+}
+
+FolderReaper::~FolderReaper()
+{
+   {
+      std::lock_guard<std::mutex> Lock(m_Mutex);
+      m_bStop.store(true);
+   }
+   m_Condition.notify_all();
+   if (m_Thread.joinable())
+      m_Thread.join();
+}
+
+/**
+ * @brief moves a folder (or a file) to a trash, the reaper's thread removes it afterwards
+ *
+ * @param path of the folder
+ *
+ * @return false if the folder exists but couldn't be moved nor removed
+ */
+const bool FolderReaper::Trash(const std::string& strFolderPath)
+{
+   const std::string strPath = WithoutTrailingSeparator(strFolderPath);
+   boost::system::error_code ec;
+   const fs::file_status Status = fs::symlink_status(strPath, ec);
+   if (Status.type() == fs::file_not_found)
+      return true;
+
+   size_t uThreads = 1;
+   if (!ec)
+   {
+      std::lock_guard<std::mutex> Lock(m_Mutex);
+      uThreads = m_uThreads;
+      const fs::path Parent = fs::path(strPath).parent_path();
+      for (const std::string& strTrash : FindTrashes(Parent.empty() ? "." : Parent.string()))
+      {
+         fs::create_directory(strTrash, ec);
+         if (ec)
+            continue;
+         if (m_setTrashes.insert(strTrash).second)
+            QueueLeftovers(strTrash);
+
+         // rename is atomic : the path is free once it returns
+         const std::string strTrashed = (fs::path(strTrash) / (GetProcessId() + '_' + std::to_string(++m_uCounter))).string();
+         fs::rename(strPath, strTrashed, ec);
+         if (!ec)
+         {
+            m_dequeTrashed.push_back(strTrashed);
+            Notify();
+            return true;
+         }
+      }
+   }
+
+   // no trash on its file system (e.g. the folder is a mount point) : removed now
+   bool bSuccess = false;
+   Directory::EraseFolder(strPath, bSuccess, uThreads);
+   return bSuccess;
+}
+
+const size_t FolderReaper::CollectLeftovers(const std::string& strPath)
+{
+   std::lock_guard<std::mutex> Lock(m_Mutex);
+   size_t uLeftovers = 0;
+   for (const std::string& strTrash : FindTrashes(strPath))
+   {
+      if (!Directory::IsDirectory(strTrash))
+         continue;
+      m_setTrashes.insert(strTrash);
+      uLeftovers += QueueLeftovers(strTrash);
+   }
+   return uLeftovers;
+}
+
+void FolderReaper::Wait()
+{
+   std::unique_lock<std::mutex> Lock(m_Mutex);
+   m_Condition.wait(Lock, [this] { return (m_dequeTrashed.empty() && m_uBusy == 0) || m_bStop.load(); });
+}
+
+void FolderReaper::SetThreadsCount(const size_t uThreads)
+{
+   std::lock_guard<std::mutex> Lock(m_Mutex);
+   m_uThreads = (uThreads == 0) ? 1 : uThreads;
+}
+
+const size_t FolderReaper::GetPendingCount()
+{
+   std::lock_guard<std::mutex> Lock(m_Mutex);
+   return m_dequeTrashed.size() + m_uBusy;
+}
+
+std::vector<std::string> FolderReaper::GetTrashes(const std::string& strFolder)
+{
+   std::lock_guard<std::mutex> Lock(m_Mutex);
+   return FindTrashes(strFolder);
+}
+
+// m_Mutex is locked
+std::vector<std::string> FolderReaper::FindTrashes(const std::string& strFolder)
+{
+   std::vector<std::string> vecTrashes;
+   boost::system::error_code ec;
+   const fs::path Folder = fs::canonical(strFolder, ec);
+   if (ec)
+      return vecTrashes;
+
+   #ifdef LINUX
+   // the root of the file system is the last parent on the same device
+   struct stat Stat;
+   if (stat(Folder.c_str(), &Stat) == 0)
+   {
+      const std::string strDevice = std::to_string(Stat.st_dev);
+      auto itRoot = m_mapRoots.find(strDevice);
+      if (itRoot == m_mapRoots.end())
+      {
+         fs::path Root = Folder;
+         struct stat ParentStat;
+         while (Root.has_parent_path() && Root != Root.root_path()
+            && stat(Root.parent_path().c_str(), &ParentStat) == 0 && ParentStat.st_dev == Stat.st_dev)
+            Root = Root.parent_path();
+         itRoot = m_mapRoots.emplace(strDevice, Root.string()).first;
+      }
+      vecTrashes.push_back((fs::path(itRoot->second) / TRASH_NAME).string());
+   }
+   #endif
+
+   const std::string strNextToFolder = (Folder / TRASH_NAME).string();
+   if (vecTrashes.empty() || vecTrashes[0] != strNextToFolder)
+      vecTrashes.push_back(strNextToFolder);
+   return vecTrashes;
+}
+
+// m_Mutex is locked
+size_t FolderReaper::QueueLeftovers(const std::string& strTrash)
+{
+   size_t uLeftovers = 0;
+   boost::system::error_code ec;
+   for (fs::directory_iterator itEntry(strTrash, ec), itEnd; !ec && itEntry != itEnd; itEntry.increment(ec))
+   {
+      if (IsLeftover(itEntry->path().filename().string()))
+      {
+         m_dequeTrashed.push_back(itEntry->path().string());
+         ++uLeftovers;
+      }
+   }
+   if (uLeftovers > 0)
+      Notify();
+   return uLeftovers;
+}
+
+// m_Mutex is locked
+void FolderReaper::Notify()
+{
+   if (!m_Thread.joinable())
+      m_Thread = std::thread(&FolderReaper::Run, this);
+   m_Condition.notify_all();
+}
+
+void FolderReaper::Run()
+{
+   std::unique_lock<std::mutex> Lock(m_Mutex);
+   for (;;)
+   {
+      m_Condition.wait(Lock, [this] { return m_bStop.load() || !m_dequeTrashed.empty(); });
+      if (m_bStop.load())
+         break;
+
+      const std::string strTrashed = std::move(m_dequeTrashed.front());
+      m_dequeTrashed.pop_front();
+      const size_t uThreads = m_uThreads;
+      ++m_uBusy;
+      Lock.unlock();
+      const size_t uRemoved = RemoveTrashed(strTrashed, uThreads, m_bStop);
+      Lock.lock();
+      --m_uBusy;
+      m_uRemoved += uRemoved;
+      m_Condition.notify_all();
+   }
+}
+
+// Snapshots
+
+/**
+ * @brief captures the state of a directory tree (recursively)
+ *
+ * @param path of the directory
+ * @param previous snapshot of the same directory, its unchanged folders aren't read again
+ *
+ * @return false if the directory couldn't be read
+ */
+const bool DirectorySnapshot::Capture(const std::string& strRoot, const DirectorySnapshot* pPrevious)
+{
+   m_strRoot = strRoot;
+   m_vecEntries.clear();
+   m_uReusedFolders = 0;
+
+   if (pPrevious == this || (pPrevious && pPrevious->m_strRoot != strRoot))
+      pPrevious = nullptr;
+
+   if (strRoot.empty() || !Directory::IsDirectory(strRoot))
+      return false;
+
+   #ifdef LINUX
+   int iDirFd = open(strRoot.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+   if (iDirFd < 0)
+      return false;
+
+   std::string strRelativePath;
+   WalkFolder(iDirFd, strRelativePath, 0, pPrevious);
+   close(iDirFd);
+   #else
+   fs::path PathDir(strRoot);
+   const size_t uRelativeOffset = strRoot.length()
+      + ((strRoot[strRoot.length() - 1] == '/' || strRoot[strRoot.length() - 1] == '\\') ? 0 : 1);
+   for (fs::recursive_directory_iterator itDir(PathDir), itEnd; itDir != itEnd; ++itDir)
+   {
+      const fs::file_status Status = itDir->symlink_status();
+      Entry NewEntry;
+      NewEntry.strRelativePath = itDir->path().generic_string().substr(uRelativeOffset);
+      NewEntry.eType = fs::is_directory(Status) ? Directory::FOLDER_ENTRY
+         : (fs::is_regular_file(Status) ? Directory::FILE_ENTRY : Directory::OTHER_ENTRY);
+      NewEntry.uInode = 0;
+      NewEntry.uSize = (NewEntry.eType == Directory::FILE_ENTRY) ? fs::file_size(itDir->path()) : 0;
+      NewEntry.iModificationTime = static_cast<int64_t>(fs::last_write_time(itDir->path())) * 1000000000;
+      m_vecEntries.push_back(std::move(NewEntry));
+   }
+   #endif
+
+   std::sort(m_vecEntries.begin(), m_vecEntries.end(), [](const Entry& A, const Entry& B)
+   {
+      return A.strRelativePath < B.strRelativePath;
+   });
+   return true;
+}
+
+#ifdef LINUX
+namespace
+{
+   DirectorySnapshot::Entry GetSnapshotEntry(const std::string& strRelativePath, const struct stat& Stat)
+   {
+      DirectorySnapshot::Entry NewEntry;
+      NewEntry.strRelativePath = strRelativePath;
+      NewEntry.eType = GetEntryType(Stat.st_mode);
+      NewEntry.uInode = Stat.st_ino;
+      NewEntry.uSize = (S_ISREG(Stat.st_mode)) ? Stat.st_size : 0;
+      NewEntry.iModificationTime = static_cast<int64_t>(Stat.st_mtim.tv_sec) * 1000000000 + Stat.st_mtim.tv_nsec;
+      return NewEntry;
+   }
+}
+
+// strRelativePath is the relative path of the folder read with iDirFd (empty for the root)
+void DirectorySnapshot::WalkFolder(int iDirFd, std::string& strRelativePath, size_t uDepth,
+   const DirectorySnapshot* pPrevious)
+{
+   while (m_vecBuffers.size() <= uDepth)
+      m_vecBuffers.emplace_back(new char[DENTS_BUFFER_SIZE]);
+
+   const size_t uPathLength = strRelativePath.length();
+
+   ReadFolder(iDirFd, m_vecBuffers[uDepth].get(), [&](const char* pszName, unsigned char)
+   {
+      struct stat Stat;
+      if (fstatat(iDirFd, pszName, &Stat, AT_SYMLINK_NOFOLLOW) != 0)
+         return true; // removed meanwhile
+
+      if (uPathLength != 0)
+         strRelativePath += '/';
+      strRelativePath += pszName;
+      m_vecEntries.push_back(GetSnapshotEntry(strRelativePath, Stat));
+      if (S_ISDIR(Stat.st_mode))
+         AddFolderContent(iDirFd, pszName, strRelativePath, uDepth, pPrevious);
+      strRelativePath.resize(uPathLength);
+      return true;
+   });
+}
+
+// the entry of the sub-folder pszName of iDirFd was just added : its content is read, or taken from the
+// previous snapshot if the folder's inode and mtime didn't change
+void DirectorySnapshot::AddFolderContent(int iDirFd, const char* pszName, std::string& strRelativePath,
+   size_t uDepth, const DirectorySnapshot* pPrevious)
+{
+   const Entry& FolderEntry = m_vecEntries.back();
+   const Entry* pPreviousEntry = (pPrevious) ? pPrevious->Find(strRelativePath) : nullptr;
+   const bool bUnchanged = pPreviousEntry && pPreviousEntry->eType == Directory::FOLDER_ENTRY
+      && pPreviousEntry->uInode == FolderEntry.uInode
+      && pPreviousEntry->iModificationTime == FolderEntry.iModificationTime;
+
+   int iSubDirFd = openat(iDirFd, pszName, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+   if (iSubDirFd < 0)
+      return;
+   if (bUnchanged)
+   {
+      ReuseFolder(iSubDirFd, strRelativePath, uDepth + 1, pPrevious);
+      ++m_uReusedFolders;
+   }
+   else
+      WalkFolder(iSubDirFd, strRelativePath, uDepth + 1, pPrevious);
+   close(iSubDirFd);
+}
+
+// the folder iDirFd didn't change : the names of its entries are those of the previous snapshot, which
+// gives the entries that aren't folders. Its sub-folders are stat'ed and checked in turn, as their content
+// changes their own mtime only.
+void DirectorySnapshot::ReuseFolder(int iDirFd, std::string& strRelativePath, size_t uDepth,
+   const DirectorySnapshot* pPrevious)
+{
+   const std::string strPrefix = strRelativePath + '/';
+   const std::vector<Entry>& vecPrevious = pPrevious->m_vecEntries;
+   auto itEntry = std::upper_bound(vecPrevious.cbegin(), vecPrevious.cend(), strPrefix,
+      [](const std::string& strPath, const Entry& CurrentEntry) { return strPath < CurrentEntry.strRelativePath; });
+
+   const size_t uPathLength = strRelativePath.length();
+   while (itEntry != vecPrevious.cend() && itEntry->strRelativePath.compare(0, strPrefix.length(), strPrefix) == 0)
+   {
+      const size_t uSeparator = itEntry->strRelativePath.find('/', strPrefix.length());
+      if (uSeparator != std::string::npos)
+      {
+         // below a sub-folder : '0' follows '/', the sub-folder's entries are before "sub-folder0"
+         const std::string strEnd = itEntry->strRelativePath.substr(0, uSeparator) + '0';
+         itEntry = std::lower_bound(itEntry, vecPrevious.cend(), strEnd,
+            [](const Entry& CurrentEntry, const std::string& strPath) { return CurrentEntry.strRelativePath < strPath; });
+         continue;
+      }
+
+      if (itEntry->eType != Directory::FOLDER_ENTRY)
+         m_vecEntries.push_back(*itEntry);
+      else
+      {
+         const char* pszName = itEntry->strRelativePath.c_str() + strPrefix.length();
+         struct stat Stat;
+         if (fstatat(iDirFd, pszName, &Stat, AT_SYMLINK_NOFOLLOW) == 0)
+         {
+            strRelativePath = itEntry->strRelativePath;
+            m_vecEntries.push_back(GetSnapshotEntry(strRelativePath, Stat));
+            if (S_ISDIR(Stat.st_mode))
+               AddFolderContent(iDirFd, pszName, strRelativePath, uDepth, pPrevious);
+            strRelativePath.resize(uPathLength);
+         }
+      }
+      ++itEntry;
+   }
+}
+#endif
+
+const DirectorySnapshot::Entry* DirectorySnapshot::Find(const std::string& strRelativePath) const
+{
+   auto itEntry = std::lower_bound(m_vecEntries.cbegin(), m_vecEntries.cend(), strRelativePath,
+      [](const Entry& CurrentEntry, const std::string& strPath) { return CurrentEntry.strRelativePath < strPath; });
+
+   if (itEntry != m_vecEntries.cend() && itEntry->strRelativePath == strRelativePath)
+      return &*itEntry;
+   return nullptr;
+}
+
+/**
+ * @brief compares two snapshots of the same directory (a single pass over the sorted entries)
+ *
+ * @return relative paths of the added, removed and modified entries
+ */
+DirectorySnapshot::Changes DirectorySnapshot::Diff(const DirectorySnapshot& OldSnapshot,
+   const DirectorySnapshot& NewSnapshot)
+{
+   Changes Result;
+   auto itOld = OldSnapshot.m_vecEntries.cbegin();
+   auto itNew = NewSnapshot.m_vecEntries.cbegin();
+
+   while (itOld != OldSnapshot.m_vecEntries.cend() || itNew != NewSnapshot.m_vecEntries.cend())
+   {
+      if (itNew == NewSnapshot.m_vecEntries.cend()
+         || (itOld != OldSnapshot.m_vecEntries.cend() && itOld->strRelativePath < itNew->strRelativePath))
+      {
+         Result.vecRemoved.push_back(itOld->strRelativePath);
+         ++itOld;
+      }
+      else if (itOld == OldSnapshot.m_vecEntries.cend() || itNew->strRelativePath < itOld->strRelativePath)
+      {
+         Result.vecAdded.push_back(itNew->strRelativePath);
+         ++itNew;
+      }
+      else
+      {
+         // a folder's mtime changes with its content, which is already reported by its own entries
+         if (itOld->eType != itNew->eType || itOld->uInode != itNew->uInode
+            || (itNew->eType != Directory::FOLDER_ENTRY
+               && (itOld->uSize != itNew->uSize || itOld->iModificationTime != itNew->iModificationTime)))
+            Result.vecModified.push_back(itNew->strRelativePath);
+         ++itOld;
+         ++itNew;
+      }
+   }
+   return Result;
+}
+
+// Watched directories
+
+#ifdef LINUX
+namespace
+{
+   constexpr uint32_t WATCH_MASK = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF
+      | IN_MOVE_SELF | IN_ONLYDIR | IN_DONT_FOLLOW;
+
+   // a continuous stream of events must not keep ProcessEvents from applying them
+   constexpr int MAX_COALESCING_ROUNDS = 64;
+
+   // relative paths of the entries below strRelativePath in a sorted container of relative paths
+   template <typename Container>
+   std::pair<typename Container::iterator, typename Container::iterator>
+   GetSubtree(Container& Paths, const std::string& strRelativePath)
+   {
+      // '0' follows '/' : [folder/, folder0) are the paths starting with "folder/"
+      return std::make_pair(Paths.lower_bound(strRelativePath + '/'), Paths.lower_bound(strRelativePath + '0'));
+   }
+}
+
+WatchedDirectory::WatchedDirectory() :
+   m_iInotifyFd(-1),
+   m_iCoalescingDelay(10),
+   m_uRescans(0)
+{
+}
+
+WatchedDirectory::~WatchedDirectory()
+{
+   Stop();
+}
+
+const bool WatchedDirectory::Start(const std::string& strRoot)
+{
+   Stop();
+
+   if (strRoot.empty() || !Directory::IsDirectory(strRoot))
+      return false;
+
+   m_iInotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+   if (m_iInotifyFd < 0)
+      return false;
+
+   m_strRoot = strRoot;
+   m_strPrefix = (strRoot[strRoot.length() - 1] == '/') ? strRoot : strRoot + '/';
+   ScanFolder("");
+   return true;
+}
+
+void WatchedDirectory::Stop()
+{
+   if (m_iInotifyFd >= 0)
+      close(m_iInotifyFd); // removes all the watches
+   m_iInotifyFd = -1;
+
+   m_mapFolderWatches.clear();
+   m_mapWatches.clear();
+   m_setPaths.clear();
+   m_mapFoldersRelAbs.clear();
+   m_mapFoldersAbsRel.clear();
+   m_mapFilesRelAbs.clear();
+   m_mapFilesAbsRel.clear();
+}
+
+std::string WatchedDirectory::GetAbsolutePath(const std::string& strRelativePath) const
+{
+   return (strRelativePath.empty()) ? m_strRoot : m_strPrefix + strRelativePath;
+}
+
+// the folder is watched before being listed : entries created meanwhile are either listed or notified
+void WatchedDirectory::ScanFolder(const std::string& strRelativePath)
+{
+   const std::string strPath = GetAbsolutePath(strRelativePath);
+   const int iWatch = inotify_add_watch(m_iInotifyFd, strPath.c_str(), WATCH_MASK);
+   if (iWatch < 0)
+      return; // symbolic link to a folder (not followed) or folder already removed
+
+   // the same folder (moved) keeps its watch descriptor
+   auto itWatch = m_mapWatches.find(iWatch);
+   if (itWatch != m_mapWatches.end())
+      m_mapFolderWatches.erase(itWatch->second);
+   m_mapWatches[iWatch] = strRelativePath;
+   m_mapFolderWatches[strRelativePath] = iWatch;
+
+   std::vector<std::string> vecSubFolders;
+   Directory::WalkOptions Options;
+   Options.bRecursive = false;
+   Directory::Walk(strPath, Options, [&](const Directory::WalkEntry& Entry)
+   {
+      const std::string strEntry = (strRelativePath.empty()) ? std::string(Entry.pszRelativePath)
+         : strRelativePath + '/' + Entry.pszRelativePath;
+      AddEntry(strEntry, Entry.eType);
+      if (Entry.eType == Directory::FOLDER_ENTRY)
+         vecSubFolders.push_back(strEntry);
+      return true;
+   });
+
+   for (const std::string& strSubFolder : vecSubFolders)
+      ScanFolder(strSubFolder);
+}
+
+void WatchedDirectory::AddEntry(const std::string& strRelativePath, const Directory::EntryType eType)
+{
+   HashMap* pMapRelAbs = (eType == Directory::FOLDER_ENTRY) ? &m_mapFoldersRelAbs : &m_mapFilesRelAbs;
+   HashMap* pMapAbsRel = (eType == Directory::FOLDER_ENTRY) ? &m_mapFoldersAbsRel : &m_mapFilesAbsRel;
+   if (eType == Directory::OTHER_ENTRY)
+      return;
+
+   const std::string strAbsolutePath = GetAbsolutePath(strRelativePath);
+   pMapRelAbs->insert(std::make_pair(strRelativePath, strAbsolutePath));
+   pMapAbsRel->insert(std::make_pair(strAbsolutePath, strRelativePath));
+   m_setPaths.insert(strRelativePath);
+}
+
+// removes the entry and, for a folder, its whole subtree
+void WatchedDirectory::RemoveEntry(const std::string& strRelativePath)
+{
+   auto Subtree = GetSubtree(m_setPaths, strRelativePath);
+   for (auto itPath = Subtree.first; itPath != Subtree.second; ++itPath)
+   {
+      const std::string strAbsolutePath = GetAbsolutePath(*itPath);
+      m_mapFoldersRelAbs.erase(*itPath);
+      m_mapFoldersAbsRel.erase(strAbsolutePath);
+      m_mapFilesRelAbs.erase(*itPath);
+      m_mapFilesAbsRel.erase(strAbsolutePath);
+   }
+   m_setPaths.erase(Subtree.first, Subtree.second);
+
+   const std::string strAbsolutePath = GetAbsolutePath(strRelativePath);
+   m_mapFoldersRelAbs.erase(strRelativePath);
+   m_mapFoldersAbsRel.erase(strAbsolutePath);
+   m_mapFilesRelAbs.erase(strRelativePath);
+   m_mapFilesAbsRel.erase(strAbsolutePath);
+   m_setPaths.erase(strRelativePath);
+
+   RemoveWatches(strRelativePath);
+}
+
+void WatchedDirectory::RemoveWatches(const std::string& strRelativePath)
+{
+   auto RemoveWatch = [this](const std::pair<const std::string, int>& Watch)
+   {
+      // the folder may have been moved elsewhere : it must not be watched any more
+      inotify_rm_watch(m_iInotifyFd, Watch.second);
+      m_mapWatches.erase(Watch.second);
+   };
+
+   auto Subtree = GetSubtree(m_mapFolderWatches, strRelativePath);
+   std::for_each(Subtree.first, Subtree.second, RemoveWatch);
+   m_mapFolderWatches.erase(Subtree.first, Subtree.second);
+
+   auto itWatch = m_mapFolderWatches.find(strRelativePath);
+   if (itWatch != m_mapFolderWatches.end())
+   {
+      RemoveWatch(*itWatch);
+      m_mapFolderWatches.erase(itWatch);
+   }
+}
+
+// brings the index in line with what is now at strRelativePath
+void WatchedDirectory::CheckPath(const std::string& strRelativePath)
+{
+   const std::string strAbsolutePath = GetAbsolutePath(strRelativePath);
+
+   struct stat Stat;
+   if (lstat(strAbsolutePath.c_str(), &Stat) != 0)
+   {
+      RemoveEntry(strRelativePath);
+      return;
+   }
+
+   // a folder created or moved here : its content wasn't watched yet
+   RemoveEntry(strRelativePath);
+   if (S_ISDIR(Stat.st_mode))
+   {
+      AddEntry(strRelativePath, Directory::FOLDER_ENTRY);
+      ScanFolder(strRelativePath);
+      return;
+   }
+
+   // symbolic links are reported with their target's type, like in the listings
+   if (S_ISLNK(Stat.st_mode) && stat(strAbsolutePath.c_str(), &Stat) != 0)
+      return;
+   AddEntry(strRelativePath, GetEntryType(Stat.st_mode));
+}
+
+const size_t WatchedDirectory::ProcessEvents(const int iTimeoutMs)
+{
+   if (m_iInotifyFd < 0)
+      return 0;
+
+   std::set<std::string> setChangedPaths;
+   bool bOverflow = false;
+   bool bRootRemoved = false;
+
+   alignas(struct inotify_event) char szBuffer[64 * 1024];
+   struct pollfd PollFd = { m_iInotifyFd, POLLIN, 0 };
+   int iWait = iTimeoutMs;
+
+   for (int iRound = 0; iRound < MAX_COALESCING_ROUNDS && poll(&PollFd, 1, iWait) > 0; ++iRound)
+   {
+      ssize_t lRead;
+      while ((lRead = read(m_iInotifyFd, szBuffer, sizeof(szBuffer))) > 0)
+      {
+         for (ssize_t lPos = 0; lPos < lRead;)
+         {
+            const struct inotify_event* pEvent = reinterpret_cast<const struct inotify_event*>(szBuffer + lPos);
+            lPos += sizeof(struct inotify_event) + pEvent->len;
+
+            if (pEvent->mask & IN_Q_OVERFLOW)
+            {
+               bOverflow = true;
+               continue;
+            }
+
+            auto itWatch = m_mapWatches.find(pEvent->wd);
+            if (itWatch == m_mapWatches.end())
+               continue; // watch already removed
+
+            if (pEvent->mask & IN_IGNORED)
+            {
+               // the folder is gone, the kernel removed its watch
+               m_mapFolderWatches.erase(itWatch->second);
+               m_mapWatches.erase(itWatch);
+               continue;
+            }
+
+            if (pEvent->mask & (IN_DELETE_SELF | IN_MOVE_SELF))
+            {
+               // other folders are reported by their parent
+               bRootRemoved |= itWatch->second.empty();
+               continue;
+            }
+
+            if (pEvent->len > 0)
+               setChangedPaths.insert((itWatch->second.empty()) ? std::string(pEvent->name)
+                  : itWatch->second + '/' + pEvent->name);
+         }
+      }
+      iWait = m_iCoalescingDelay;
+   }
+
+   if (bRootRemoved)
+   {
+      const size_t uCount = m_setPaths.size();
+      Stop();
+      return uCount;
+   }
+
+   if (bOverflow)
+   {
+      // some events were lost, the changed folders aren't known : the whole tree is read again
+      const std::string strRoot = m_strRoot;
+      const size_t uRescans = m_uRescans + 1;
+      Start(strRoot);
+      m_uRescans = uRescans;
+      return m_setPaths.size();
+   }
+
+   // removed paths first : a moved folder must release its watch before being watched at its new location
+   std::vector<std::string> vecExistingPaths;
+   for (const std::string& strPath : setChangedPaths)
+   {
+      struct stat Stat;
+      if (lstat(GetAbsolutePath(strPath).c_str(), &Stat) != 0)
+         RemoveEntry(strPath);
+      else
+         vecExistingPaths.push_back(strPath);
+   }
+   for (const std::string& strPath : vecExistingPaths)
+      CheckPath(strPath);
+
+   return setChangedPaths.size();
 }
+#endif
@@ -10,20 +10,58 @@
 #ifndef INCLUDE_LOCALREP_H_
 #define INCLUDE_LOCALREP_H_
 
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
 #include <boost/filesystem.hpp>
-/* to count '/' occurrences in a path (used to sort the folders/files listing) */
-#include <boost/range/algorithm/count.hpp>
+#ifndef LINUX
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#endif
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <deque>
 #include <fstream>
 #include <functional>
+#include <iomanip>
 #include <iostream>
+#include <iterator>
+#include <limits>
 #include <string>
 #include <sstream>
+#include <stdexcept>
 #include <map>
 #include <memory>
+#include <set>
+#include <mutex>
+#include <numeric>
+#include <thread>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#ifdef LINUX
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
+#endif
+
 #include "libzippp.h"
 
 // the same size I use in my MD5 SHA1 Calculator....
@@ -68,31 +106,413 @@ namespace Zip
    const bool AddDirectoryEntryToZip(const std::string& strZipFile, const std::string& strZipEntry);
 }
 
+namespace FlatSortedMapDetail
+{
+   /* the comparisons work on the keys only */
+   struct NoSortKey
+   {
+      template <typename K>
+      explicit NoSortKey(const K&) {}
+   };
+
+   /* Compare::Key when the comparison has a key computed once per element, NoSortKey otherwise */
+   template <typename Compare>
+   class SortKeyOf
+   {
+      template <typename U> static typename U::Key Test(int);
+      template <typename U> static NoSortKey Test(...);
+
+   public:
+      typedef decltype(Test<Compare>(0)) Type;
+   };
+}
+
+/**
+ * @brief read-only sorted map stored in a contiguous vector
+ *
+ * The pairs are sorted once when the map is filled (assign), lookups are binary searches and the
+ * iteration walks the vector : no node per entry. Same const interface as std::map, the elements can't
+ * be inserted or erased one by one.
+ * When the comparison provides a Key (like Directory::SlashOccurrencesComparison), the keys of the
+ * elements are stored next to the pairs and the searched key's one is computed once per lookup.
+ */
+template <typename K, typename T, typename Compare = std::less<K>>
+class FlatSortedMap
+{
+public:
+   typedef K key_type;
+   typedef T mapped_type;
+   typedef std::pair<K, T> value_type;
+   typedef Compare key_compare;
+   typedef typename std::vector<value_type>::size_type size_type;
+   typedef typename std::vector<value_type>::const_iterator const_iterator;
+   typedef const_iterator iterator;
+
+   FlatSortedMap() = default;
+
+   inline const_iterator begin() const { return m_vecPairs.cbegin(); }
+   inline const_iterator end() const { return m_vecPairs.cend(); }
+   inline const_iterator cbegin() const { return m_vecPairs.cbegin(); }
+   inline const_iterator cend() const { return m_vecPairs.cend(); }
+   inline size_type size() const { return m_vecPairs.size(); }
+   inline bool empty() const { return m_vecPairs.empty(); }
+
+   const_iterator lower_bound(const K& Key) const
+   {
+      return m_vecPairs.cbegin() + LowerBound(Key, SortKey(Key));
+   }
+
+   const_iterator find(const K& Key) const
+   {
+      const SortKey SearchedKey(Key);
+      const size_type uIndex = LowerBound(Key, SearchedKey);
+      return (uIndex != m_vecPairs.size() && !Less(Key, SearchedKey, m_vecPairs[uIndex].first, m_vecKeys[uIndex]))
+         ? m_vecPairs.cbegin() + uIndex : m_vecPairs.cend();
+   }
+
+   inline size_type count(const K& Key) const { return (find(Key) != m_vecPairs.cend()) ? 1 : 0; }
+
+   const T& at(const K& Key) const
+   {
+      const_iterator it = find(Key);
+      if (it == m_vecPairs.cend())
+         throw std::out_of_range("FlatSortedMap::at");
+      return it->second;
+   }
+
+   T& at(const K& Key)
+   {
+      const_iterator it = find(Key);
+      if (it == m_vecPairs.cend())
+         throw std::out_of_range("FlatSortedMap::at");
+      return m_vecPairs[it - m_vecPairs.cbegin()].second;
+   }
+
+   /* sorts the pairs, the first one of equal keys is kept (as std::map::insert would do) */
+   void assign(std::vector<value_type>&& vecPairs)
+   {
+      std::stable_sort(vecPairs.begin(), vecPairs.end(),
+         [this](const value_type& A, const value_type& B) { return m_Compare(A.first, B.first); });
+      assign_sorted(std::move(vecPairs));
+   }
+
+   /* the pairs are already sorted by the caller, equal keys are removed (compared with ==, as distinct
+      keys can be equivalent for a comparison which isn't a strict weak ordering) */
+   void assign_sorted(std::vector<value_type>&& vecPairs)
+   {
+      vecPairs.erase(std::unique(vecPairs.begin(), vecPairs.end(),
+         [](const value_type& A, const value_type& B) { return A.first == B.first; }), vecPairs.end());
+      m_vecPairs = std::move(vecPairs);
+
+      m_vecKeys.clear();
+      m_vecKeys.reserve(m_vecPairs.size());
+      for (const value_type& Pair : m_vecPairs)
+         m_vecKeys.push_back(SortKey(Pair.first));
+   }
+
+   inline void clear() { m_vecPairs.clear(); m_vecKeys.clear(); }
+
+   inline size_t GetMemoryUsage() const
+   { return m_vecPairs.capacity() * sizeof(value_type) + m_vecKeys.capacity() * sizeof(SortKey); }
+
+   inline bool operator==(const FlatSortedMap& Other) const { return m_vecPairs == Other.m_vecPairs; }
+   inline bool operator!=(const FlatSortedMap& Other) const { return m_vecPairs != Other.m_vecPairs; }
+
+private:
+   typedef typename FlatSortedMapDetail::SortKeyOf<Compare>::Type SortKey;
+
+   inline bool Less(const K& A, const FlatSortedMapDetail::NoSortKey&, const K& B,
+      const FlatSortedMapDetail::NoSortKey&) const
+   { return m_Compare(A, B); }
+
+   template <typename Key>
+   inline bool Less(const K& A, const Key& KeyA, const K& B, const Key& KeyB) const
+   { return Compare::Compare(A, KeyA, B, KeyB); }
+
+   size_type LowerBound(const K& Key, const SortKey& SearchedKey) const
+   {
+      size_type uFirst = 0;
+      size_type uCount = m_vecPairs.size();
+      while (uCount > 0)
+      {
+         const size_type uStep = uCount / 2;
+         const size_type uMiddle = uFirst + uStep;
+         if (Less(m_vecPairs[uMiddle].first, m_vecKeys[uMiddle], Key, SearchedKey))
+         {
+            uFirst = uMiddle + 1;
+            uCount -= uStep + 1;
+         }
+         else
+            uCount = uStep;
+      }
+      return uFirst;
+   }
+
+   std::vector<value_type> m_vecPairs;
+   std::vector<SortKey> m_vecKeys; // empty structs when the comparison has no Key
+   Compare m_Compare;
+};
+
+/* read-only view of a '\0' terminated string stored in a pool (FlatHashMap, StringArena, EntryTable) */
+class PooledString
+{
+public:
+   PooledString() : m_pszData(""), m_uLength(0) {}
+   PooledString(const char* pszData, const size_t uLength) : m_pszData(pszData), m_uLength(uLength) {}
+   /* views of strings which outlive them (lookup keys) */
+   PooledString(const std::string& strData) : m_pszData(strData.c_str()), m_uLength(strData.length()) {}
+   PooledString(const char* pszData) : m_pszData(pszData), m_uLength(std::strlen(pszData)) {}
+
+   inline const char* data() const { return m_pszData; }
+   inline const char* c_str() const { return m_pszData; }
+   inline const char* begin() const { return m_pszData; }
+   inline const char* end() const { return m_pszData + m_uLength; }
+   inline size_t size() const { return m_uLength; }
+   inline size_t length() const { return m_uLength; }
+   inline bool empty() const { return m_uLength == 0; }
+   inline std::string str() const { return std::string(m_pszData, m_uLength); }
+   inline operator std::string() const { return str(); }
+
+   inline bool Equals(const char* pszData, const size_t uLength) const
+   { return m_uLength == uLength && std::memcmp(m_pszData, pszData, uLength) == 0; }
+
+   /* same order as std::string */
+   inline bool operator<(const PooledString& Other) const
+   {
+      const int iCompare = std::memcmp(m_pszData, Other.m_pszData, std::min(m_uLength, Other.m_uLength));
+      return (iCompare != 0) ? iCompare < 0 : m_uLength < Other.m_uLength;
+   }
+
+private:
+   const char* m_pszData;
+   size_t m_uLength;
+};
+
+inline bool operator==(const PooledString& A, const PooledString& B) { return A.Equals(B.data(), B.size()); }
+inline bool operator==(const PooledString& A, const std::string& B) { return A.Equals(B.data(), B.size()); }
+inline bool operator==(const std::string& A, const PooledString& B) { return B.Equals(A.data(), A.size()); }
+inline bool operator==(const PooledString& A, const char* B) { return A.Equals(B, std::strlen(B)); }
+inline bool operator==(const char* A, const PooledString& B) { return B.Equals(A, std::strlen(A)); }
+template <typename T> inline bool operator!=(const PooledString& A, const T& B) { return !(A == B); }
+inline bool operator!=(const std::string& A, const PooledString& B) { return !(B == A); }
+inline bool operator!=(const char* A, const PooledString& B) { return !(B == A); }
+inline std::ostream& operator<<(std::ostream& Stream, const PooledString& Str)
+{ return Stream.write(Str.data(), Str.size()); }
+inline std::string operator+(const std::string& A, const PooledString& B) { return std::string(A).append(B.data(), B.size()); }
+inline std::string operator+(const PooledString& A, const std::string& B) { return A.str().append(B); }
+
+/**
+ * @brief monotonic storage of strings, released in one step
+ *
+ * The strings are copied ('\0' terminated) at the end of the current block, a new block is only
+ * allocated when it's full. Reset rewinds the storage without freeing it (the next strings reuse
+ * the same memory), the blocks are merged in a single one so that the next fill of the same size
+ * doesn't allocate at all. A copy of an arena is empty : the strings stay owned by their arena.
+ */
+class StringArena
+{
+public:
+   explicit StringArena(const size_t uBlockSize = 64 * 1024) :
+      m_uBlockSize(uBlockSize), m_uBlock(0), m_uOffset(0), m_uUsedSize(0) {}
+   StringArena(const StringArena& Other) :
+      m_uBlockSize(Other.m_uBlockSize), m_uBlock(0), m_uOffset(0), m_uUsedSize(0) {}
+   StringArena& operator=(const StringArena&) { Reset(); return *this; }
+
+   PooledString Store(const char* pszData, const size_t uLength);
+   inline PooledString Store(const std::string& strData) { return Store(strData.data(), strData.length()); }
+
+   void Reset();
+   void Release();
+
+   inline const size_t GetUsedSize() const { return m_uUsedSize; }
+   const size_t GetCapacity() const;
+
+private:
+   struct Block
+   {
+      std::unique_ptr<char[]> pData;
+      size_t uSize;
+   };
+
+   std::vector<Block> m_vecBlocks;
+   size_t m_uBlockSize;
+   size_t m_uBlock;  // current block
+   size_t m_uOffset; // in the current block
+   size_t m_uUsedSize;
+};
+
+/**
+ * @brief string to string hash map with open addressing, insertions only
+ *
+ * Keys and values are appended to a single string pool ('\0' terminated, each key preceded by the
+ * index of its entry), the slots (linear probing) hold the 64-bit hash of the key next to its offset in
+ * the pool : a lookup reads the slot and the key (only when the hashes are equal), growing doesn't
+ * hash the keys again. The keys can't contain '\0'.
+ * The iteration goes through the entries in insertion order, the elements are pairs of PooledStrings
+ * (returned by value, not references) which are valid until the next insertion.
+ */
+class FlatHashMap
+{
+public:
+   typedef PooledString key_type;
+   typedef PooledString mapped_type;
+   typedef std::pair<PooledString, PooledString> value_type;
+   typedef size_t size_type;
+
+   /* the pairs are built from the pool when dereferenced and returned by value : an input iterator */
+   class const_iterator
+   {
+   public:
+      /* holds the pair for operator-> */
+      struct ArrowProxy
+      {
+         value_type Pair;
+         inline const value_type* operator->() const { return &Pair; }
+      };
+
+      typedef std::input_iterator_tag iterator_category;
+      typedef FlatHashMap::value_type value_type;
+      typedef std::ptrdiff_t difference_type;
+      typedef ArrowProxy pointer;
+      typedef value_type reference;
+
+      const_iterator() : m_pMap(nullptr), m_uIndex(0) {}
+      const_iterator(const FlatHashMap* pMap, const size_t uIndex) : m_pMap(pMap), m_uIndex(uIndex) {}
+
+      inline reference operator*() const { return m_pMap->GetPair(m_uIndex); }
+      inline pointer operator->() const { return pointer{ **this }; }
+      inline const_iterator& operator++() { ++m_uIndex; return *this; }
+      inline const_iterator operator++(int) { const_iterator itPrevious(*this); ++m_uIndex; return itPrevious; }
+      inline bool operator==(const const_iterator& Other) const { return m_uIndex == Other.m_uIndex && m_pMap == Other.m_pMap; }
+      inline bool operator!=(const const_iterator& Other) const { return !(*this == Other); }
+
+   private:
+      const FlatHashMap* m_pMap;
+      size_t m_uIndex;
+   };
+   typedef const_iterator iterator;
+
+   FlatHashMap() : m_uSlotsMask(0) {}
+
+   inline const_iterator begin() const { return const_iterator(this, 0); }
+   inline const_iterator end() const { return const_iterator(this, m_vecEntries.size()); }
+   inline const_iterator cbegin() const { return begin(); }
+   inline const_iterator cend() const { return end(); }
+   inline size_type size() const { return m_vecEntries.size(); }
+   inline bool empty() const { return m_vecEntries.empty(); }
+
+   /* sizes the slots for a count of entries (and the pool for a total length of keys and values) */
+   void reserve(const size_t uEntries, const size_t uPoolSize = 0);
+   void clear();
+
+   std::pair<const_iterator, bool> insert(const char* pszKey, const size_t uKeyLength,
+                                          const char* pszValue, const size_t uValueLength);
+   inline std::pair<const_iterator, bool> insert(const std::pair<std::string, std::string>& Pair)
+   { return insert(Pair.first.data(), Pair.first.length(), Pair.second.data(), Pair.second.length()); }
+
+   /* the keys can be given as std::string or const char* (PooledString views them) */
+   const_iterator find(const char* pszKey, const size_t uKeyLength) const;
+   inline const_iterator find(const PooledString& Key) const { return find(Key.data(), Key.size()); }
+   inline size_type count(const PooledString& Key) const { return (find(Key) != end()) ? 1 : 0; }
+   PooledString at(const PooledString& Key) const;
+
+   inline size_t GetMemoryUsage() const
+   {
+      return m_strPool.capacity() + m_vecEntries.capacity() * sizeof(Entry) + m_vecSlots.capacity() * sizeof(Slot);
+   }
+
+   /* same pairs, whatever the insertion order */
+   bool operator==(const FlatHashMap& Other) const;
+   inline bool operator!=(const FlatHashMap& Other) const { return !(*this == Other); }
+
+   static uint64_t Hash(const char* pszData, const size_t uLength);
+
+private:
+   struct Entry
+   {
+      size_t uKeyOffset; // the value follows the key's '\0'
+      size_t uKeyLength;
+      size_t uValueLength;
+   };
+   struct Slot
+   {
+      uint64_t uHash;
+      size_t uKeyOffset; // 0 : empty slot (the entry index precedes a key)
+   };
+
+   inline value_type GetPair(const size_t uIndex) const
+   {
+      const Entry& Item = m_vecEntries[uIndex];
+      const char* pszKey = m_strPool.data() + Item.uKeyOffset;
+      return value_type(PooledString(pszKey, Item.uKeyLength),
+                        PooledString(pszKey + Item.uKeyLength + 1, Item.uValueLength));
+   }
+
+   inline size_t GetEntryIndex(const size_t uKeyOffset) const
+   {
+      size_t uEntry;
+      std::memcpy(&uEntry, m_strPool.data() + uKeyOffset - sizeof(uEntry), sizeof(uEntry));
+      return uEntry;
+   }
+
+   size_t FindSlot(const char* pszKey, const size_t uKeyLength, const uint64_t uHash) const;
+   void Rehash(const size_t uSlotsCount);
+
+   std::string m_strPool;
+   std::vector<Entry> m_vecEntries;
+   std::vector<Slot> m_vecSlots;
+   size_t m_uSlotsMask;
+};
+
+class DirectoryIndex;
+
 class Directory
 {
 public:
    // functor to sort the vector of paths according to '/' occurences
    struct SlashOccurrencesComparison
    {
-      // TODO : slashes - back-slashes management has to be optimized...
-      bool operator()(const std::string& strA, const std::string& strB)
+      /* separators counts of a path : computed once per path when the same paths are compared many times */
+      struct Key
+      {
+         template <typename Path>
+         explicit Key(const Path& strPath) : uBackSlashes(0), uSlashes(0)
+         {
+            for (const char c : strPath)
+            {
+               if (c == '/')
+                  ++uSlashes;
+               else if (c == '\\')
+                  ++uBackSlashes;
+            }
+         }
+
+         inline const bool HasSeparator() const { return uBackSlashes != 0 || uSlashes != 0; }
+
+         size_t uBackSlashes;
+         size_t uSlashes;
+      };
+
+      /* Path : std::string or PooledString */
+      template <typename Path>
+      static bool Compare(const Path& strA, const Key& KeyA, const Path& strB, const Key& KeyB)
       {
-         if ((strA.find_first_of('\\') != std::string::npos) || (strA.find_first_of('/') != std::string::npos))
+         if (KeyA.HasSeparator())
          {
-            if ((strB.find_first_of('\\') != std::string::npos) || (strB.find_first_of('/') != std::string::npos))
+            if (KeyB.HasSeparator())
             {
-               if ((boost::count(strA, '\\') == boost::count(strB, '\\') && boost::count(strA, '\\') != 0)
-                  || (boost::count(strA, '/') == boost::count(strB, '/') && boost::count(strA, '/') != 0))
+               if ((KeyA.uBackSlashes == KeyB.uBackSlashes && KeyA.uBackSlashes != 0)
+                  || (KeyA.uSlashes == KeyB.uSlashes && KeyA.uSlashes != 0))
                   return strA < strB;
-               else if (strA.find_first_of('\\') != std::string::npos)
-                  return (boost::count(strA, '\\') < boost::count(strB, '\\'));
+               else if (KeyA.uBackSlashes != 0)
+                  return (KeyA.uBackSlashes < KeyB.uBackSlashes);
                else
-                  return (boost::count(strA, '/') < boost::count(strB, '/'));
+                  return (KeyA.uSlashes < KeyB.uSlashes);
             }
             else
                return false;
          }
-         else if ((strB.find_first_of('\\') != std::string::npos) || (strB.find_first_of('/') != std::string::npos))
+         else if (KeyB.HasSeparator())
             return true;
 
          if (strA.length() == strB.length())
@@ -100,10 +520,19 @@ public:
 
          return (strA.length() < strB.length());
       }
+
+      template <typename Path>
+      bool operator()(const Path& strA, const Path& strB) const
+      {
+         return Compare(strA, Key(strA), strB, Key(strB));
+      }
    };
 
    typedef std::unordered_map<std::string, std::string> HashMap;
    typedef std::map<std::string, std::string, SlashOccurrencesComparison> SortedMap;
+   /* same pairs as views of the listing's paths (valid until the next listing) : no allocation per entry */
+   typedef FlatHashMap HashMapView;
+   typedef FlatSortedMap<PooledString, PooledString, SlashOccurrencesComparison> SortedMapView;
 
    enum PathType
    {
@@ -111,6 +540,206 @@ public:
       RELATIVE_PATH
    };
 
+   enum EntryType
+   {
+      FOLDER_ENTRY,
+      FILE_ENTRY,
+      OTHER_ENTRY // symbolic links are resolved, so this is a dangling link, a socket, a FIFO...
+   };
+
+   /* collected during the walk if requested (symbolic links are followed, like for the entry type) */
+   struct EntryMetadata
+   {
+      uint64_t uSize;
+      std::time_t tModificationTime;
+      uint32_t uMode;  // st_mode (only the permissions with the portable walk)
+      uint64_t uInode; // 0 with the portable walk
+   };
+
+   /* entry reported by Walk */
+   struct WalkEntry
+   {
+      const std::string& strAbsolutePath; // e.g. /home/amzoughi/A/foobar.txt
+      const char* pszRelativePath;        // e.g. A/foobar.txt (points inside strAbsolutePath)
+      EntryType eType;
+      const EntryMetadata* pMetadata;     // nullptr unless WalkOptions::bMetadata is set
+      int iFolderFd;                      // descriptor of the entry's folder while the visitor runs (e.g. to
+                                          // unlinkat the entry), -1 unless the walk is a serial one under Linux
+   };
+
+   /* returns false to stop the walk */
+   typedef std::function<bool(const WalkEntry&)> WalkVisitor;
+
+   /* filters pushed down into the walk : excluded folders and the folders at the maximum depth
+    * are never read, patterns are compiled once when they are added (not for each entry) */
+   class WalkFilter
+   {
+   public:
+      /* files whose name matches one of the patterns ('*' and '?' wildcards, e.g. "*.txt", "log_??.*") */
+      WalkFilter& AddPattern(const std::string& strPattern);
+      /* files with one of the extensions (e.g. "txt" or ".txt") */
+      WalkFilter& AddExtension(const std::string& strExtension);
+      /* folders whose name matches (wildcards allowed, e.g. ".git", "node_modules") are neither reported nor read */
+      WalkFilter& ExcludeFolder(const std::string& strPattern);
+      /* files size in bytes, bounds included */
+      WalkFilter& SetSizeRange(const uint64_t uMinSize, const uint64_t uMaxSize = UINT64_MAX);
+      /* files last write time, bounds included */
+      WalkFilter& SetModificationTimeRange(const std::time_t tFrom, const std::time_t tTo);
+      /* 1 : only the root's entries, 0 : no limit */
+      WalkFilter& SetMaxDepth(const size_t uMaxDepth);
+
+      const bool IsFolderExcluded(const char* pszName) const;
+      const bool IsFileNameAccepted(const char* pszName) const;
+      const bool IsFileStatAccepted(const uint64_t uSize, const std::time_t tModificationTime) const;
+
+      /* the size and time ranges need a stat of each file */
+      inline const bool NeedsStat() const { return m_bSizeRange || m_bTimeRange; }
+      inline const size_t GetMaxDepth() const { return m_uMaxDepth; }
+      /* true if the folder at this depth (1 for the root's entries) can be read */
+      inline const bool CanDescend(const size_t uDepth) const { return m_uMaxDepth == 0 || uDepth < m_uMaxDepth; }
+
+   private:
+      struct Pattern
+      {
+         enum Kind { EXACT, PREFIX, SUFFIX, WILDCARDS } eKind;
+         std::string strText; // without the leading/trailing '*' for PREFIX and SUFFIX
+      };
+
+      static Pattern Compile(const std::string& strPattern);
+      static const bool Match(const Pattern& CompiledPattern, const char* pszName, const size_t uLength);
+
+      std::vector<Pattern> m_vecPatterns;
+      std::unordered_set<std::string> m_setExtensions;
+      std::unordered_set<std::string> m_setExcludedNames; // exclusions without wildcards
+      std::vector<Pattern> m_vecExcludedPatterns;
+      bool m_bSizeRange = false;
+      uint64_t m_uMinSize = 0;
+      uint64_t m_uMaxSize = UINT64_MAX;
+      bool m_bTimeRange = false;
+      std::time_t m_tFrom = 0;
+      std::time_t m_tTo = 0;
+      size_t m_uMaxDepth = 0;
+   };
+
+   /* time spent and errors swallowed by a walk */
+   struct WalkStats
+   {
+      uint64_t uReadDirNanoseconds = 0; // reading the folders (getdents64, directory iterators)
+      uint64_t uStatNanoseconds = 0;    // stat calls (links, file systems without d_type, metadata, filters)
+      size_t uErrors = 0;               // folders which couldn't be opened or read, entries which couldn't be stat'ed
+
+      WalkStats& operator+=(const WalkStats& Other);
+   };
+
+   struct WalkOptions
+   {
+      bool bRecursive = true;
+      size_t uThreads = 1;
+      bool bMetadata = false; // stat each entry during the walk (statx on Linux)
+      WalkFilter Filter;
+      WalkStats* pStats = nullptr; // accumulates the walk's times and errors if set
+   };
+
+   struct CleanUpOptions
+   {
+      bool bRecursive = false;
+      bool bStreaming = false; // the files are deleted during the walk : the memory used doesn't depend on their count
+      size_t uThreads = 1;     // folders cleaned up in parallel (Linux), in batches of one folder
+      bool bPruneEmptyFolders = false; // with bRecursive, the sub-folders emptied by the clean-up are removed, deepest first
+   };
+
+   /* criteria of ApplyRetention, applied in this order (the default values disable them) */
+   struct RetentionPolicy
+   {
+      size_t uMaxAgeDays = SIZE_MAX;       // files last modified more days ago are deleted
+      size_t uKeepPerFolder = SIZE_MAX;    // newest files kept in each folder, the older ones are deleted
+      uint64_t uMaxTotalSize = UINT64_MAX; // the oldest files are deleted until the total size is at most this
+   };
+
+   /* memory held by a Directory object and where the time of its last listing went */
+   struct Statistics
+   {
+      size_t uFolders = 0;
+      size_t uFiles = 0;
+
+      // bytes allocated (capacities)
+      size_t uFoldersTableBytes = 0;   // root, relative paths pool and offsets
+      size_t uFilesTableBytes = 0;
+      size_t uMetadataBytes = 0;       // folders and files metadata tables
+      size_t uHashMapsBytes = 0;       // the hash maps and their views (estimated for the std::unordered_maps)
+      size_t uSortedMapsBytes = 0;     // the sorted maps and their views (estimated for the std::maps)
+      size_t uAbsolutePathsBytes = 0;  // arenas of the absolute paths shared by the maps
+      size_t uTotalBytes = 0;
+
+      // last listing (the maps are built on request : their times are summed since the listing)
+      uint64_t uListingNanoseconds = 0;
+      uint64_t uReadDirNanoseconds = 0;
+      uint64_t uStatNanoseconds = 0;
+      uint64_t uSortNanoseconds = 0;
+      uint64_t uMapBuildNanoseconds = 0; // sorting excluded
+      size_t uErrors = 0;
+
+      /* Prometheus text exposition, e.g. ToPrometheus("sync_directory", "root=\"/data\"") */
+      std::string ToPrometheus(const std::string& strPrefix = "localrep_directory",
+                               const std::string& strLabels = "") const;
+   };
+
+   /* listed paths of one kind (folders or files) : the root is stored once and each entry only
+    * by its relative path in a single string pool, absolute path = root + relative path */
+   class EntryTable
+   {
+   public:
+      inline const size_t Size() const { return m_vecOffsets.size(); }
+      inline const std::string& GetRoot() const { return m_strRoot; }
+      inline const size_t GetPoolSize() const { return m_strPool.size(); }
+
+      /* relative paths are '\0' terminated */
+      inline const char* GetRelativePath(const size_t uIndex) const { return m_strPool.data() + m_vecOffsets[uIndex]; }
+      inline const size_t GetRelativePathLength(const size_t uIndex) const
+      {
+         return ((uIndex + 1 < m_vecOffsets.size()) ? m_vecOffsets[uIndex + 1] : m_strPool.size())
+            - m_vecOffsets[uIndex] - 1;
+      }
+      std::string GetAbsolutePath(const size_t uIndex) const;
+      void GetAbsolutePath(const size_t uIndex, std::string& strAbsolutePath) const; // reuses the string's buffer
+      const size_t GetMemoryUsage() const;
+
+      void Clear();
+      void Add(const std::string& strAbsolutePath, const std::string& strRelativePath);
+
+   private:
+      std::string m_strRoot;
+      std::string m_strPool;
+      std::vector<size_t> m_vecOffsets;
+   };
+
+   /* metadata of the entries of an EntryTable (same indexes), one array per field so that
+    * queries on sizes or times only read the array they need */
+   class MetadataTable
+   {
+   public:
+      inline const size_t Size() const { return m_vecSizes.size(); }
+      inline const uint64_t GetSize(const size_t uIndex) const { return m_vecSizes[uIndex]; }
+      inline const std::time_t GetModificationTime(const size_t uIndex) const { return m_vecModificationTimes[uIndex]; }
+      inline const uint32_t GetMode(const size_t uIndex) const { return m_vecModes[uIndex]; }
+      inline const uint64_t GetInode(const size_t uIndex) const { return m_vecInodes[uIndex]; }
+
+      inline const std::vector<uint64_t>& GetSizes() const { return m_vecSizes; }
+      inline const std::vector<std::time_t>& GetModificationTimes() const { return m_vecModificationTimes; }
+
+      const uint64_t GetTotalSize() const;
+      const size_t GetMemoryUsage() const;
+
+      void Clear();
+      void Add(const EntryMetadata& Metadata);
+
+   private:
+      std::vector<uint64_t> m_vecSizes;
+      std::vector<std::time_t> m_vecModificationTimes;
+      std::vector<uint32_t> m_vecModes;
+      std::vector<uint64_t> m_vecInodes;
+   };
+
    /* class methods */
    static const bool CreateFolder(const std::string& strPath);
    static const bool CreateDirectories(const std::string& strPath);
@@ -122,12 +751,62 @@ public:
    
    static const bool Rename(const std::string& strFilePath, const std::string& strNewName);
    static const bool EraseFile(const std::string& strFilePath);
-   static const size_t EraseFolder(const std::string& strFolderPath, bool& bSuccess);
+   static const size_t EraseFolder(const std::string& strFolderPath, bool& bSuccess, const size_t uThreads = 1);
+   /* moves the folder to the trash of its file system and returns at once, FolderReaper removes it */
+   static const bool EraseFolderAsync(const std::string& strFolderPath);
    static std::time_t GetLastWriteTime(const std::string& strFilePath);
    static const size_t CleanUpFiles(const std::string& strDirectory,
                                     const size_t& usKeepDays,
                                     const bool& bRecursive = false);
+   static const size_t CleanUpFiles(const std::string& strDirectory,
+                                    const size_t& usKeepDays,
+                                    const CleanUpOptions& Options);
+   static const size_t ApplyRetention(const std::string& strDirectory,
+                                      const RetentionPolicy& Policy);
+   static const size_t ApplyRetention(const std::string& strDirectory,
+                                      const RetentionPolicy& Policy,
+                                      const CleanUpOptions& Options);
    static const size_t FileSize(const std::string& strFile, bool& bSuccess);
+   static const bool Walk(const std::string& strRoot, const WalkOptions& Options, const WalkVisitor& Visitor);
+   /* sorts paths like the sorted maps (SlashOccurrencesComparison order) */
+   static void SortPaths(std::vector<std::string>& vecPaths);
+
+   /* existence, type and metadata of many paths at once, in the order of the paths (symbolic links
+    * are followed) : the lookups are io_uring statx requests in flight together under Linux, or are
+    * spread over uThreads threads when io_uring isn't available */
+   struct PathStatus
+   {
+      bool bExists;
+      EntryType eType;
+      EntryMetadata Metadata;
+   };
+   static std::vector<PathStatus> StatMany(const std::vector<std::string>& vecPaths, const size_t uThreads = 8);
+
+   /* makes the next io_uring_enter of StatMany fail with iErrno once its requests are submitted
+    * (0 : no failure), to exercise the recovery and the fallback in the tests */
+   static void InjectStatManyFailure(const int iErrno);
+
+   /* space used by a folder and its subtree : the folders themselves and the symbolic links (not
+    * followed) are counted, like du does, a file with several hard links only once */
+   struct FolderUsage
+   {
+      uint64_t uApparentSize = 0;  // sum of the sizes
+      uint64_t uAllocatedSize = 0; // sum of the allocated blocks (same as the apparent size if unknown)
+      size_t uFiles = 0;           // entries other than folders
+      size_t uFolders = 0;         // sub-folders
+   };
+   struct DiskUsageOptions
+   {
+      size_t uThreads = 1;
+      size_t uMaxDepth = 0; // deeper folders are only counted in their parents (0 : all the folders)
+   };
+   struct DiskUsageResult
+   {
+      FolderUsage Total; // the whole tree, the root folder included
+      FlatSortedMap<std::string, FolderUsage, SlashOccurrencesComparison> mapFolders; // same keys as GetMapSortedFoldersRelAbs()
+      size_t uErrors = 0; // entries that couldn't be read (not counted)
+   };
+   static const bool DiskUsage(const std::string& strRoot, const DiskUsageOptions& Options, DiskUsageResult& Result);
 
    /* object methods */
    std::string ListFolders(const std::string& strLocation,
@@ -138,41 +817,490 @@ public:
       bool bRecursive = false,
       PathType ePathType = ABSOLUTE_PATH);
 
-   inline const size_t GetFilesCount() const { return m_mapFilesAbsRel.size(); }
-   inline const size_t GetFoldersCount() const { return m_mapFoldersAbsRel.size(); }
+   /* fills both folders and files maps with a single traversal */
+   std::string ListTree(const std::string& strPath,
+      bool bRecursive = false,
+      PathType ePathType = ABSOLUTE_PATH);
 
-   const HashMap& GetMapFoldersRelAbs() const { return m_mapFoldersRelAbs; }
+   /* count of threads reading the folders during the recursive listings (default : 1, a serial walk)
+    * the listing results and their order don't depend on it */
+   inline void SetThreadsCount(const size_t uThreads) { m_uThreads = (uThreads == 0) ? 1 : uThreads; }
+   inline const size_t GetThreadsCount() const { return m_uThreads; }
+
+   /* filter applied by the next listings (the default one keeps every entry) */
+   inline void SetFilter(const WalkFilter& Filter) { m_Filter = Filter; }
+   inline const WalkFilter& GetFilter() const { return m_Filter; }
+
+   /* if set, the next listings also fill the metadata tables (one statx per entry during the walk) */
+   inline void SetMetadataCollection(const bool bMetadata) { m_bMetadata = bMetadata; }
+   inline const bool GetMetadataCollection() const { return m_bMetadata; }
+
+   inline const size_t GetFilesCount() const { return m_Files.Size(); }
+   inline const size_t GetFoldersCount() const { return m_Folders.Size(); }
+
+   const EntryTable& GetFolders() const { return m_Folders; }
+
+   const EntryTable& GetFiles() const { return m_Files; }
+
+   /* empty unless the metadata collection is enabled, indexes are the ones of GetFolders() and GetFiles() */
+   const MetadataTable& GetFoldersMetadata() const { return m_FoldersMetadata; }
+
+   const MetadataTable& GetFilesMetadata() const { return m_FilesMetadata; }
+
+   /* entry counts, memory held by the object and times of the last listing */
+   const Statistics Stats() const;
+
+   /* the maps are built from the tables above on their first request */
+   const HashMap& GetMapFoldersRelAbs() const;
    
-   const HashMap& GetMapFoldersAbsRel() const { return m_mapFoldersAbsRel; }
+   const HashMap& GetMapFoldersAbsRel() const;
    
-   const SortedMap& GetMapSortedFoldersAbsRel() const { return m_mapSortedFoldersAbsRel; }
+   const SortedMap& GetMapSortedFoldersAbsRel() const;
    
-   const SortedMap& GetMapSortedFoldersRelAbs() const { return m_mapSortedFoldersRelAbs; }
+   const SortedMap& GetMapSortedFoldersRelAbs() const;
    
-   const HashMap& GetMapFilesRelAbs() const { return m_mapFilesRelAbs; }
+   const HashMap& GetMapFilesRelAbs() const;
    
-   const HashMap& GetMapFilesAbsRel() const { return m_mapFilesAbsRel; }
+   const HashMap& GetMapFilesAbsRel() const;
    
-   const SortedMap& GetMapSortedFilesAbsRel() const { return m_mapSortedFilesAbsRel; }
+   const SortedMap& GetMapSortedFilesAbsRel() const;
    
-   const SortedMap& GetMapSortedFilesRelAbs() const { return m_mapSortedFilesRelAbs; }
+   const SortedMap& GetMapSortedFilesRelAbs() const;
+
+   /* the same maps as views of the listing's paths, much cheaper to build : valid until the next listing */
+   const HashMapView& GetMapFoldersRelAbsView() const;
+
+   const HashMapView& GetMapFoldersAbsRelView() const;
+
+   const SortedMapView& GetMapSortedFoldersAbsRelView() const;
+
+   const SortedMapView& GetMapSortedFoldersRelAbsView() const;
+
+   const HashMapView& GetMapFilesRelAbsView() const;
+
+   const HashMapView& GetMapFilesAbsRelView() const;
+
+   const SortedMapView& GetMapSortedFilesAbsRelView() const;
+
+   const SortedMapView& GetMapSortedFilesRelAbsView() const;
+
+   /* writes the last listing (tables, metadata if collected and the folders' mtimes) to a binary
+    * file that DirectoryIndex maps without parsing it, save it right after the listing */
+   const bool SaveIndex(const std::string& strIndexFile) const;
+   /* fills the tables (and the metadata) from an index instead of listing the directory */
+   const bool LoadIndex(const DirectoryIndex& Index);
 
 protected:
+   std::string ListEntries(const std::string& strLocation, bool bRecursive, PathType ePathType,
+      bool bFolders, bool bFiles);
+   static EntryType GetEntryType(const fs::file_status& Status);
+   static const size_t CleanUpFilesStreaming(const std::string& strDirectory, const size_t& usKeepDays,
+      const CleanUpOptions& Options);
+   static const size_t PruneEmptyFolders(const std::string& strDirectory, std::vector<std::string>& vecFolders);
+   void AddEntry(const std::string& strAbsolutePath, EntryType eType, const EntryMetadata* pMetadata,
+      const std::string& strLoc, PathType ePathType, bool bFolders, bool bFiles, std::string& strList);
+   void ClearFolders();
+   void ClearFiles();
+
+   /* absolute paths of a table's entries, stored once in an arena for all the maps. A copy is empty (its
+      views would point into the source's arena) */
+   struct AbsolutePaths
+   {
+      AbsolutePaths() = default;
+      AbsolutePaths(const AbsolutePaths&) {}
+      AbsolutePaths& operator=(const AbsolutePaths&) { Clear(); return *this; }
+      inline void Clear() { Arena.Reset(); vecPaths.clear(); }
+
+      StringArena Arena;
+      std::vector<PooledString> vecPaths;
+   };
+
+   /* MapFlags of the maps already built from the tables. Not copied : the sorted views point into the
+      object's tables and arenas, a copy builds the maps again. The const getters build the maps under the
+      mutex, so that they can be called from several threads like before the maps were built lazily */
+   struct BuiltMaps
+   {
+      BuiltMaps() : uFlags(0) {}
+      BuiltMaps(const BuiltMaps&) : uFlags(0) {}
+      BuiltMaps& operator=(const BuiltMaps&) { uFlags = 0; return *this; }
+
+      std::atomic<unsigned> uFlags;
+      std::mutex Mutex;
+   };
+
+   template <typename Map>
+   const Map& GetMap(Map& mapPaths, const EntryTable& Table, AbsolutePaths& Paths, const bool bRelativeKeys,
+      const unsigned uMapFlag) const;
+
+   enum MapFlags
+   {
+      FOLDERS_REL_ABS_MAP        = 1 << 0,
+      FOLDERS_ABS_REL_MAP        = 1 << 1,
+      SORTED_FOLDERS_REL_ABS_MAP = 1 << 2,
+      SORTED_FOLDERS_ABS_REL_MAP = 1 << 3,
+      FILES_REL_ABS_MAP          = 1 << 4,
+      FILES_ABS_REL_MAP          = 1 << 5,
+      SORTED_FILES_REL_ABS_MAP   = 1 << 6,
+      SORTED_FILES_ABS_REL_MAP   = 1 << 7,
+      VIEWS                      = 1 << 8, // shift of the views' flags
+      FOLDERS_MAPS               = 0x0F0F,
+      FILES_MAPS                 = 0xF0F0
+   };
+
    // If "C:\XXXX" was listed :
+   EntryTable m_Folders; // root C:\XXXX\ e.g. A, A\B, A\B\C (recursively)
+   EntryTable m_Files;   // root C:\XXXX\ e.g. data.txt, A\foobar.txt (recursively)
+   MetadataTable m_FoldersMetadata;
+   MetadataTable m_FilesMetadata;
+
    // Only folders paths (relative -> absolute paths and vice versa)
-   HashMap m_mapFoldersRelAbs; // Unordered e.g. A -> C:\XXXX\A
-   HashMap m_mapFoldersAbsRel; // Unordered e.g. C:\XXXX\A -> A
-   SortedMap m_mapSortedFoldersRelAbs; // Ordered e.g. A -> C:\XXXX\A
-   SortedMap m_mapSortedFoldersAbsRel; // Ordered e.g. C:\XXXX\A -> A
+   mutable HashMap m_mapFoldersRelAbs; // Unordered e.g. A -> C:\XXXX\A
+   mutable HashMap m_mapFoldersAbsRel; // Unordered e.g. C:\XXXX\A -> A
+   mutable SortedMap m_mapSortedFoldersRelAbs; // Ordered e.g. A -> C:\XXXX\A
+   mutable SortedMap m_mapSortedFoldersAbsRel; // Ordered e.g. C:\XXXX\A -> A
    /* recursively e.g. A\B\C <-> C:\XXXX\A\B\C and vice versa */
    
    // Only files paths (relative -> absolute paths and vice versa)
-   HashMap m_mapFilesRelAbs; // Unordered e.g. A\foobar.txt -> C:\XXXX\A\foobar.txt
-   HashMap m_mapFilesAbsRel; // Unordered e.g. C:\XXXX\A\foobar.txt -> A\foobar.txt
-   SortedMap m_mapSortedFilesRelAbs; // Ordered e.g. A\foobar.txt -> C:\XXXX\A\foobar.txt
-   SortedMap m_mapSortedFilesAbsRel; // Ordered e.g. C:\XXXX\A\foobar.txt -> A\foobar.txt
+   mutable HashMap m_mapFilesRelAbs; // Unordered e.g. A\foobar.txt -> C:\XXXX\A\foobar.txt
+   mutable HashMap m_mapFilesAbsRel; // Unordered e.g. C:\XXXX\A\foobar.txt -> A\foobar.txt
+   mutable SortedMap m_mapSortedFilesRelAbs; // Ordered e.g. A\foobar.txt -> C:\XXXX\A\foobar.txt
+   mutable SortedMap m_mapSortedFilesAbsRel; // Ordered e.g. C:\XXXX\A\foobar.txt -> A\foobar.txt
    /* not recursively e.g. data.txt <-> C:\XXXX\data.txt and vice versa */
 
+   // Same maps, as views
+   mutable HashMapView m_mapFoldersRelAbsView;
+   mutable HashMapView m_mapFoldersAbsRelView;
+   mutable SortedMapView m_mapSortedFoldersRelAbsView;
+   mutable SortedMapView m_mapSortedFoldersAbsRelView;
+   mutable HashMapView m_mapFilesRelAbsView;
+   mutable HashMapView m_mapFilesAbsRelView;
+   mutable SortedMapView m_mapSortedFilesRelAbsView;
+   mutable SortedMapView m_mapSortedFilesAbsRelView;
+
+   mutable AbsolutePaths m_FoldersPaths;
+   mutable AbsolutePaths m_FilesPaths;
+   mutable BuiltMaps m_BuiltMaps;
+   mutable Statistics m_Times; // only the times and errors are kept up to date
+   std::string m_strPathBuffer; // relative path of the entry being added
+
+   size_t m_uThreads = 1;
+   bool m_bMetadata = false;
+   WalkFilter m_Filter;
+
+   // last listing, for SaveIndex
+   std::string m_strLocation;
+   bool m_bRecursive = false;
+
+};
+
+/**
+ * @brief state of a directory tree (relative path, inode, size and mtime of each entry) used to detect
+ * the changes between two listings
+ *
+ * Capturing a snapshot with the previous one skips the folders whose inode and mtime didn't change :
+ * their subtree is taken from the previous snapshot without being read again. A folder's mtime only
+ * changes when entries are added, removed or renamed directly inside it, so a file rewritten in place
+ * inside an unchanged folder is only seen by a full capture (without previous snapshot).
+ */
+class DirectorySnapshot
+{
+public:
+   struct Entry
+   {
+      std::string strRelativePath; // e.g. A/foobar.txt
+      Directory::EntryType eType;  // symbolic links aren't followed (OTHER_ENTRY)
+      uint64_t uInode;             // 0 if not available (non POSIX systems)
+      uint64_t uSize;
+      int64_t iModificationTime;   // nanoseconds since the epoch
+   };
+
+   /* relative paths, sorted */
+   struct Changes
+   {
+      std::vector<std::string> vecAdded;
+      std::vector<std::string> vecRemoved;
+      std::vector<std::string> vecModified; // files : inode, size or mtime changed, folders : inode changed
+   };
+
+   const bool Capture(const std::string& strRoot, const DirectorySnapshot* pPrevious = nullptr);
+
+   static Changes Diff(const DirectorySnapshot& OldSnapshot, const DirectorySnapshot& NewSnapshot);
+
+   inline const std::string& GetRoot() const { return m_strRoot; }
+
+   /* sorted by relative path, a folder's subtree is contiguous */
+   inline const std::vector<Entry>& GetEntries() const { return m_vecEntries; }
+
+   /* folders of the last capture whose entries were taken from the previous snapshot (not read again) */
+   inline const size_t GetReusedFoldersCount() const { return m_uReusedFolders; }
+
+   const Entry* Find(const std::string& strRelativePath) const;
+
+protected:
+   void WalkFolder(int iDirFd, std::string& strRelativePath, size_t uDepth, const DirectorySnapshot* pPrevious);
+   void AddFolderContent(int iDirFd, const char* pszName, std::string& strRelativePath, size_t uDepth,
+      const DirectorySnapshot* pPrevious);
+   void ReuseFolder(int iDirFd, std::string& strRelativePath, size_t uDepth, const DirectorySnapshot* pPrevious);
+
+   std::string m_strRoot;
+   std::vector<Entry> m_vecEntries;
+   size_t m_uReusedFolders = 0;
+   std::vector<std::unique_ptr<char[]>> m_vecBuffers;
+};
+
+/**
+ * @brief read-only view of a listing saved by Directory::SaveIndex
+ *
+ * The file is mapped in memory and used as is : opening it only checks its header, the paths are read
+ * from the string pool and the lookups are binary searches in the sorted indexes. The index tells by
+ * itself if the tree changed since it was saved : entries added, removed or renamed change the mtime
+ * of their folder, which is compared to the saved one (files modified in place aren't detected).
+ */
+class DirectoryIndex
+{
+public:
+   DirectoryIndex() = default;
+   ~DirectoryIndex();
+
+   DirectoryIndex(const DirectoryIndex&) = delete;
+   DirectoryIndex& operator=(const DirectoryIndex&) = delete;
+
+   const bool Open(const std::string& strIndexFile);
+   void Close();
+   inline const bool IsOpen() const { return m_pHeader != nullptr; }
+
+   /* directory given to the saved listing */
+   const char* GetLocation() const;
+   const bool IsRecursive() const;
+
+   const size_t GetFoldersCount() const;
+   const size_t GetFilesCount() const;
+
+   /* same roots and relative paths as the listing's tables (Directory::EntryTable) */
+   const char* GetFoldersRoot() const;
+   const char* GetFilesRoot() const;
+   const char* GetFolderRelativePath(const size_t uIndex) const;
+   const char* GetFileRelativePath(const size_t uIndex) const;
+
+   /* metadata, only if it was collected by the saved listing */
+   const bool HasMetadata() const;
+   const uint64_t GetFolderSize(const size_t uIndex) const;
+   const std::time_t GetFolderModificationTime(const size_t uIndex) const;
+   const uint64_t GetFileSize(const size_t uIndex) const;
+   const std::time_t GetFileModificationTime(const size_t uIndex) const;
+
+   /* binary searches, uIndex is the entry's index in the tables */
+   const bool FindFolder(const std::string& strRelativePath, size_t& uIndex) const;
+   const bool FindFile(const std::string& strRelativePath, size_t& uIndex) const;
+
+   /* stats the saved folders and compares their mtimes (all of them or only the ones in a subtree,
+    * given by its absolute path), false if one of them changed or disappeared */
+   const bool Validate() const;
+   const bool ValidateFolder(const std::string& strAbsolutePath) const;
+
+   struct Header;
+   struct Table;
+
+protected:
+   const Table& GetTable(const bool bFolders) const;
+   const char* GetRelativePath(const Table& IndexTable, const size_t uIndex) const;
+   const bool Find(const Table& IndexTable, const std::string& strRelativePath, size_t& uIndex) const;
+   const bool ValidateRange(const size_t uBegin, const size_t uEnd) const;
+
+   template <typename T>
+   inline const T* At(const uint64_t uOffset) const { return reinterpret_cast<const T*>(m_pData + uOffset); }
+
+   const char* m_pData = nullptr;
+   size_t m_uSize = 0;
+   const Header* m_pHeader = nullptr;
+   #ifndef LINUX
+   boost::interprocess::file_mapping m_File;
+   boost::interprocess::mapped_region m_Region;
+   #endif
+};
+
+/**
+ * @brief token bucket limiting the removals of CleanUpFiles, ApplyRetention and EraseFolder (and of the
+ * FolderReaper's thread), shared by all of them so that they don't exceed the rates together (without
+ * LINUX, EraseFolder uses fs::remove_all and isn't limited)
+ *
+ * Each removal is one operation, the size of a deleted file counts in the bytes (the files are only
+ * stat'ed for it when a bytes rate is set). A bucket holds one second of each rate : beyond, the thread
+ * removing the entry sleeps until the debt is paid back. The removing threads can also run with the
+ * idle I/O priority class (Linux, effective with the BFQ scheduler) : their requests are served only
+ * when the disk has nothing else to do.
+ */
+class IoThrottle
+{
+public:
+   static IoThrottle& GetInstance();
+
+   IoThrottle(const IoThrottle&) = delete;
+   IoThrottle& operator=(const IoThrottle&) = delete;
+
+   /* rates of the removals, 0 for no limit (the default) */
+   void SetLimits(const uint64_t uOpsPerSecond, const uint64_t uBytesPerSecond);
+
+   /* the removing threads use IOPRIO_CLASS_IDLE, the callers' priority is restored afterwards */
+   inline void SetIdlePriority(const bool bIdle) { m_bIdlePriority.store(bIdle); }
+   inline const bool IsIdlePriority() const { return m_bIdlePriority.load(); }
+
+   inline const bool IsLimited() const { return m_bLimited.load(); }
+   inline const bool LimitsBytes() const { return m_bLimitsBytes.load(); }
+
+   /* takes the tokens of uOps removals of uBytes in total, sleeps if the bucket is empty */
+   void Acquire(const uint64_t uOps, const uint64_t uBytes);
+
+   inline const uint64_t GetThrottledNanoseconds() const { return m_uThrottledNanoseconds.load(); } // slept
+   inline const uint64_t GetThrottledCount() const { return m_uThrottledCount.load(); }             // sleeps
+   void ResetCounters();
+
+protected:
+   IoThrottle();
+
+   std::mutex m_Mutex;
+   double m_dOpsRate;                                  // per second, 0 : no limit
+   double m_dBytesRate;
+   double m_dOpsTokens;                                // negative : debt
+   double m_dBytesTokens;
+   std::chrono::steady_clock::time_point m_tLastRefill;
+   std::atomic<bool> m_bLimited;
+   std::atomic<bool> m_bLimitsBytes;
+   std::atomic<bool> m_bIdlePriority;
+   std::atomic<uint64_t> m_uThrottledNanoseconds;
+   std::atomic<uint64_t> m_uThrottledCount;
+};
+
+/**
+ * @brief removes folders in the background : a folder is renamed into the trash of its file system
+ * (the path is free at once) and a thread removes the content of the trash afterwards
+ *
+ * The trash is the TRASH_NAME folder at the root of the file system, or next to the folder when the
+ * root can't be written (or is another mount of the file system). The leftovers of the processes
+ * which stopped before their trash was emptied are removed too, when a trash is used for the first
+ * time or by CollectLeftovers (e.g. at startup).
+ */
+class FolderReaper
+{
+public:
+   static FolderReaper& GetInstance();
+
+   FolderReaper(const FolderReaper&) = delete;
+   FolderReaper& operator=(const FolderReaper&) = delete;
+
+   /* returns false if the folder (or file) exists but couldn't be removed : when it can't be moved
+    * to a trash, it is removed before returning (EraseFolder) */
+   const bool Trash(const std::string& strFolderPath);
+
+   /* trashes which can receive the entries of the folder, in the order they are tried */
+   std::vector<std::string> GetTrashes(const std::string& strFolder);
+
+   /* queues the leftovers of the trashes of the file system holding strPath, returns their count */
+   const size_t CollectLeftovers(const std::string& strPath);
+
+   /* blocks until the trashed folders are removed */
+   void Wait();
+
+   /* threads removing each trashed folder (EraseFolder's uThreads) */
+   void SetThreadsCount(const size_t uThreads);
+
+   const size_t GetPendingCount();
+   inline const size_t GetRemovedCount() const { return m_uRemoved.load(); } // entries removed
+
+   static const char* const TRASH_NAME;
+
+protected:
+   FolderReaper();
+   ~FolderReaper(); // stops the removal in progress, the rest is left for the next process
+
+   std::vector<std::string> FindTrashes(const std::string& strFolder);
+   size_t QueueLeftovers(const std::string& strTrash);
+   void Notify();
+   void Run();
+
+   std::mutex m_Mutex;
+   std::condition_variable m_Condition;
+   std::deque<std::string> m_dequeTrashed;             // paths in the trashes, removed in this order
+   std::map<std::string, std::string> m_mapRoots;      // file system (device) -> root
+   std::set<std::string> m_setTrashes;                 // trashes already checked for leftovers
+   std::thread m_Thread;                               // started by the first Trash
+   std::atomic<bool> m_bStop;
+   size_t m_uBusy;                                     // folders being removed
+   size_t m_uThreads;
+   size_t m_uCounter;                                  // makes the names in the trashes unique
+   std::atomic<size_t> m_uRemoved;
+};
+
+#ifdef LINUX
+/**
+ * @brief index of a directory tree listed once, then kept up to date with inotify
+ *
+ * Relative paths use '/' and don't start with a separator (e.g. A/foobar.txt), absolute paths are
+ * the root followed by the relative path. Queries are hash map lookups : the tree isn't read again.
+ * The changes are applied by ProcessEvents, call it from the thread using the index (or protect both).
+ */
+class WatchedDirectory
+{
+public:
+   typedef std::unordered_map<std::string, std::string> HashMap;
+
+   WatchedDirectory();
+   ~WatchedDirectory();
+
+   WatchedDirectory(const WatchedDirectory&) = delete;
+   WatchedDirectory& operator=(const WatchedDirectory&) = delete;
+
+   /* lists the directory recursively and watches all its folders */
+   const bool Start(const std::string& strRoot);
+   void Stop();
+   inline const bool IsStarted() const { return m_iInotifyFd >= 0; }
+
+   /* waits up to iTimeoutMs for changes and applies them, returns the count of paths updated
+    * events of a burst are coalesced : once an event is received, the ones coming in the next
+    * coalescing delay are read too and each changed path is only checked once */
+   const size_t ProcessEvents(const int iTimeoutMs = 0);
+
+   inline void SetCoalescingDelay(const int iDelayMs) { m_iCoalescingDelay = iDelayMs; }
+
+   inline const bool IsFile(const std::string& strRelativePath) const
+   { return m_mapFilesRelAbs.find(strRelativePath) != m_mapFilesRelAbs.end(); }
+   inline const bool IsFolder(const std::string& strRelativePath) const
+   { return m_mapFoldersRelAbs.find(strRelativePath) != m_mapFoldersRelAbs.end(); }
+
+   inline const size_t GetFilesCount() const { return m_mapFilesRelAbs.size(); }
+   inline const size_t GetFoldersCount() const { return m_mapFoldersRelAbs.size(); }
+
+   const HashMap& GetMapFoldersRelAbs() const { return m_mapFoldersRelAbs; }
+   const HashMap& GetMapFoldersAbsRel() const { return m_mapFoldersAbsRel; }
+   const HashMap& GetMapFilesRelAbs() const { return m_mapFilesRelAbs; }
+   const HashMap& GetMapFilesAbsRel() const { return m_mapFilesAbsRel; }
+
+   /* full rescans done after the kernel's event queue overflowed */
+   inline const size_t GetRescansCount() const { return m_uRescans; }
+
+protected:
+   std::string GetAbsolutePath(const std::string& strRelativePath) const;
+   void ScanFolder(const std::string& strRelativePath);
+   void CheckPath(const std::string& strRelativePath);
+   void AddEntry(const std::string& strRelativePath, const Directory::EntryType eType);
+   void RemoveEntry(const std::string& strRelativePath);
+   void RemoveWatches(const std::string& strRelativePath);
+
+   std::string m_strRoot;
+   std::string m_strPrefix; // root with a trailing separator
+   int m_iInotifyFd;
+   int m_iCoalescingDelay;
+   size_t m_uRescans;
+
+   std::map<std::string, int> m_mapFolderWatches;     // relative path -> watch descriptor (sorted for subtrees)
+   std::unordered_map<int, std::string> m_mapWatches; // watch descriptor -> relative path
+   std::set<std::string> m_setPaths;                  // all the entries (sorted for subtrees)
+
+   HashMap m_mapFoldersRelAbs;
+   HashMap m_mapFoldersAbsRel;
+   HashMap m_mapFilesRelAbs;
+   HashMap m_mapFilesAbsRel;
 };
+#endif
 
 #endif // INCLUDE_LOCALREP_H_
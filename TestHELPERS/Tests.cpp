@@ -154,6 +154,1353 @@ TEST_F(HelpersTest, FilesListRecursively)
       m_oDirectory.GetMapFilesRelAbs()));
 }
 
+TEST_F(HelpersTest, TreeListRecursively)
+{
+   std::string strResult = m_oDirectory.ListTree(TEST_FOLDER, true);
+   EXPECT_FALSE(strResult.empty());
+
+   // a single traversal must produce the same maps as the two separate listings
+   Directory oSeparateLists;
+   oSeparateLists.ListFolders(TEST_FOLDER, true);
+   oSeparateLists.ListFiles(TEST_FOLDER, true);
+
+   EXPECT_EQ(oSeparateLists.GetFoldersCount(), m_oDirectory.GetFoldersCount());
+   EXPECT_EQ(oSeparateLists.GetFilesCount(), m_oDirectory.GetFilesCount());
+
+   EXPECT_TRUE(::AreMapsEqual(oSeparateLists.GetMapSortedFoldersAbsRel(),
+      m_oDirectory.GetMapFoldersAbsRel()));
+   EXPECT_TRUE(::AreMapsEqual(oSeparateLists.GetMapSortedFoldersRelAbs(),
+      m_oDirectory.GetMapFoldersRelAbs()));
+   EXPECT_TRUE(::AreMapsEqual(oSeparateLists.GetMapSortedFilesAbsRel(),
+      m_oDirectory.GetMapFilesAbsRel()));
+   EXPECT_TRUE(::AreMapsEqual(oSeparateLists.GetMapSortedFilesRelAbs(),
+      m_oDirectory.GetMapFilesRelAbs()));
+}
+
+TEST_F(HelpersTest, EntryTables)
+{
+   m_oDirectory.ListTree(TEST_FOLDER, true);
+
+   const Directory::EntryTable& Files = m_oDirectory.GetFiles();
+   ASSERT_EQ(m_oDirectory.GetFilesCount(), Files.Size());
+   ASSERT_EQ(m_oDirectory.GetFoldersCount(), m_oDirectory.GetFolders().Size());
+
+   // the maps are built from the table : absolute path = root + relative path
+   const Directory::HashMap& mapFilesRelAbs = m_oDirectory.GetMapFilesRelAbs();
+   for (size_t uIndex = 0; uIndex < Files.Size(); ++uIndex)
+   {
+      const std::string strRelativePath(Files.GetRelativePath(uIndex), Files.GetRelativePathLength(uIndex));
+      EXPECT_EQ(Files.GetRoot() + strRelativePath, Files.GetAbsolutePath(uIndex));
+
+      auto itFile = mapFilesRelAbs.find(strRelativePath);
+      ASSERT_TRUE(itFile != mapFilesRelAbs.end());
+      EXPECT_EQ(itFile->second, Files.GetAbsolutePath(uIndex));
+   }
+}
+
+TEST_F(HelpersTest, ParallelListRecursively)
+{
+   std::string strSerialResult = m_oDirectory.ListTree(TEST_FOLDER, true);
+
+   // the parallel walk must give the same listing (in the same order) and the same maps
+   Directory oParallelList;
+   oParallelList.SetThreadsCount(4);
+   EXPECT_EQ(4, oParallelList.GetThreadsCount());
+   std::string strParallelResult = oParallelList.ListTree(TEST_FOLDER, true);
+
+   EXPECT_EQ(strSerialResult, strParallelResult);
+   EXPECT_TRUE(::AreMapsEqual(m_oDirectory.GetMapSortedFoldersRelAbs(),
+      oParallelList.GetMapFoldersRelAbs()));
+   EXPECT_TRUE(::AreMapsEqual(m_oDirectory.GetMapSortedFilesRelAbs(),
+      oParallelList.GetMapFilesRelAbs()));
+}
+
+// run with --gtest_also_run_disabled_tests
+TEST_F(HelpersTest, DISABLED_BenchmarkParallelListing)
+{
+   const std::string strBenchFolder = TEST_FOLDER + "BENCH_LISTING/";
+   const size_t uFolders = 256;
+   const size_t uSubFolders = 8;
+   const size_t uFilesPerFolder = 64;
+
+   for (size_t uFolder = 0; uFolder < uFolders; ++uFolder)
+   {
+      for (size_t uSubFolder = 0; uSubFolder < uSubFolders; ++uSubFolder)
+      {
+         const std::string strFolder = strBenchFolder + std::to_string(uFolder) + "/" + std::to_string(uSubFolder) + "/";
+         ASSERT_TRUE(Directory::CreateDirectories(strFolder));
+         for (size_t uFile = 0; uFile < uFilesPerFolder; ++uFile)
+            std::ofstream ofsDummy(strFolder + "file_" + std::to_string(uFile) + ".txt");
+      }
+   }
+
+   std::string strSerialResult;
+   for (size_t uThreads = 1; uThreads <= 32; uThreads *= 2)
+   {
+      Directory oBenchDirectory;
+      oBenchDirectory.SetThreadsCount(uThreads);
+
+      auto tStart = std::chrono::steady_clock::now();
+      std::string strResult = oBenchDirectory.ListTree(strBenchFolder, true);
+      auto tElapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - tStart);
+
+      std::cout << "[ BENCH    ] " << uThreads << " thread(s) : " << oBenchDirectory.GetFilesCount() << " files, "
+         << oBenchDirectory.GetFoldersCount() << " folders listed in " << tElapsed.count() << " ms" << std::endl;
+
+      if (uThreads == 1)
+         strSerialResult = strResult;
+      else
+         EXPECT_EQ(strSerialResult, strResult);
+   }
+
+   bool bSuccess = false;
+   Directory::EraseFolder(strBenchFolder, bSuccess);
+   EXPECT_TRUE(bSuccess);
+}
+
+TEST_F(HelpersTest, RepeatedListings)
+{
+   m_oDirectory.ListTree(TEST_FOLDER, true);
+   std::map<std::string, std::string, Directory::SlashOccurrencesComparison> mapExpected;
+   for (const auto& File : m_oDirectory.GetMapSortedFilesRelAbsView())
+      mapExpected.insert(std::make_pair(File.first.str(), File.second.str()));
+   ASSERT_FALSE(mapExpected.empty());
+   // the maps own their paths : a copy outlives the next listing
+   const Directory::SortedMap mapOwned = m_oDirectory.GetMapSortedFilesRelAbs();
+   EXPECT_TRUE(mapOwned == mapExpected);
+
+   // the second listing reuses the storage of the first one
+   m_oDirectory.ListTree(TEST_FOLDER, true);
+   const Directory::SortedMapView& mapFiles = m_oDirectory.GetMapSortedFilesRelAbsView();
+   ASSERT_EQ(mapExpected.size(), mapFiles.size());
+   EXPECT_TRUE(std::equal(mapFiles.begin(), mapFiles.end(), mapExpected.cbegin(),
+      [](const Directory::SortedMapView::value_type& Pair, const std::pair<const std::string, std::string>& Item)
+      { return Pair.first == Item.first && Pair.second == Item.second; }));
+   EXPECT_TRUE(::AreMapsEqual(mapExpected, m_oDirectory.GetMapFilesRelAbsView()));
+   EXPECT_TRUE(::AreMapsEqual(mapOwned, m_oDirectory.GetMapFilesRelAbs()));
+   EXPECT_TRUE(m_oDirectory.GetMapSortedFilesRelAbs() == mapOwned);
+
+   // a copy builds its own views
+   std::unique_ptr<Directory> pCopy(new Directory(m_oDirectory));
+   const Directory::SortedMapView mapCopied = pCopy->GetMapSortedFilesAbsRelView();
+   EXPECT_TRUE(mapCopied == m_oDirectory.GetMapSortedFilesAbsRelView());
+   const char* pszCopiedPath = pCopy->GetMapSortedFilesAbsRelView().begin()->first.c_str();
+   EXPECT_NE(m_oDirectory.GetMapSortedFilesAbsRelView().begin()->first.c_str(), pszCopiedPath);
+}
+
+TEST_F(HelpersTest, ConcurrentMapGetters)
+{
+   m_oDirectory.ListTree(TEST_FOLDER, true);
+   const Directory& Listed = m_oDirectory;
+
+   // the maps are built on the first call, by one of the threads
+   std::vector<size_t> vecSizes(8, 0);
+   std::vector<std::thread> vecThreads;
+   for (size_t uThread = 0; uThread < vecSizes.size(); ++uThread)
+      vecThreads.emplace_back([&Listed, &vecSizes, uThread]()
+      {
+         vecSizes[uThread] = (uThread % 2) ? Listed.GetMapSortedFilesRelAbs().size() : Listed.GetMapFilesRelAbsView().size();
+         Listed.Stats();
+      });
+   for (std::thread& Thread : vecThreads)
+      Thread.join();
+
+   for (const size_t uSize : vecSizes)
+      EXPECT_EQ(Listed.GetFilesCount(), uSize);
+   EXPECT_TRUE(::AreMapsEqual(Listed.GetMapSortedFilesRelAbs(), Listed.GetMapFilesRelAbsView()));
+}
+
+TEST_F(HelpersTest, DirectoryStats)
+{
+   m_oDirectory.SetMetadataCollection(true);
+   m_oDirectory.ListTree(TEST_FOLDER, true);
+   Directory::Statistics Stats = m_oDirectory.Stats();
+   EXPECT_EQ(m_oDirectory.GetFoldersCount(), Stats.uFolders);
+   EXPECT_EQ(m_oDirectory.GetFilesCount(), Stats.uFiles);
+   EXPECT_GT(Stats.uFilesTableBytes, 0u);
+   EXPECT_GT(Stats.uMetadataBytes, 0u);
+   EXPECT_EQ(0u, Stats.uSortedMapsBytes);
+   EXPECT_GT(Stats.uListingNanoseconds, 0u);
+   EXPECT_GT(Stats.uReadDirNanoseconds, 0u);
+   EXPECT_GT(Stats.uStatNanoseconds, 0u);
+   EXPECT_GE(Stats.uListingNanoseconds, Stats.uReadDirNanoseconds);
+   EXPECT_EQ(0u, Stats.uErrors);
+
+   // the maps are accounted once built
+   m_oDirectory.GetMapSortedFilesRelAbs();
+   m_oDirectory.GetMapFilesRelAbs();
+   Stats = m_oDirectory.Stats();
+   EXPECT_GT(Stats.uSortedMapsBytes, 0u);
+   EXPECT_GT(Stats.uHashMapsBytes, 0u);
+   EXPECT_GT(Stats.uAbsolutePathsBytes, 0u);
+   EXPECT_GT(Stats.uSortNanoseconds, 0u);
+   EXPECT_GT(Stats.uMapBuildNanoseconds, 0u);
+   EXPECT_EQ(Stats.uFoldersTableBytes + Stats.uFilesTableBytes + Stats.uMetadataBytes + Stats.uHashMapsBytes
+      + Stats.uSortedMapsBytes + Stats.uAbsolutePathsBytes, Stats.uTotalBytes);
+
+   const std::string strText = Stats.ToPrometheus("sync", "job=\"test\"");
+   EXPECT_NE(std::string::npos, strText.find("# TYPE sync_entries gauge\n"));
+   EXPECT_NE(std::string::npos, strText.find("sync_entries{type=\"file\",job=\"test\"} "
+      + std::to_string(Stats.uFiles) + "\n"));
+   EXPECT_NE(std::string::npos, strText.find("sync_time_seconds{phase=\"readdir\",job=\"test\"} "));
+   EXPECT_NE(std::string::npos, strText.find("sync_errors{job=\"test\"} 0\n"));
+   m_oDirectory.SetMetadataCollection(false);
+}
+
+TEST_F(HelpersTest, WalkRecursively)
+{
+   m_oDirectory.ListTree(TEST_FOLDER, true);
+   const Directory::HashMap& mapFilesRelAbs = m_oDirectory.GetMapFilesRelAbs();
+
+   size_t uFilesCount = 0;
+   size_t uFoldersCount = 0;
+   Directory::WalkOptions Options;
+   Options.bRecursive = true;
+   EXPECT_TRUE(Directory::Walk(TEST_FOLDER, Options, [&](const Directory::WalkEntry& Entry)
+   {
+      if (Entry.eType == Directory::FILE_ENTRY)
+      {
+         ++uFilesCount;
+         auto itFile = mapFilesRelAbs.find(Entry.pszRelativePath);
+         EXPECT_TRUE(itFile != mapFilesRelAbs.end() && itFile->second == Entry.strAbsolutePath);
+      }
+      else if (Entry.eType == Directory::FOLDER_ENTRY)
+         ++uFoldersCount;
+      return true;
+   }));
+   EXPECT_EQ(m_oDirectory.GetFilesCount(), uFilesCount);
+   EXPECT_EQ(m_oDirectory.GetFoldersCount(), uFoldersCount);
+
+   // the visitor stops the walk
+   size_t uVisitedCount = 0;
+   EXPECT_TRUE(Directory::Walk(TEST_FOLDER, Options, [&](const Directory::WalkEntry&)
+   {
+      ++uVisitedCount;
+      return false;
+   }));
+   EXPECT_EQ(1, uVisitedCount);
+
+   // check for failure
+   EXPECT_FALSE(Directory::Walk(TEST_FOLDER + "inexistent_folder", Options,
+      [](const Directory::WalkEntry&) { return true; }));
+}
+
+TEST_F(HelpersTest, SortPaths)
+{
+   std::vector<std::string> vecPaths = GeneratePaths(10000);
+   std::map<std::string, int, Directory::SlashOccurrencesComparison> mapExpected;
+   for (const std::string& strPath : vecPaths)
+      mapExpected.insert(std::make_pair(strPath, 0));
+
+   Directory::SortPaths(vecPaths);
+
+   ASSERT_EQ(mapExpected.size(), vecPaths.size());
+   EXPECT_TRUE(std::equal(vecPaths.cbegin(), vecPaths.cend(), mapExpected.cbegin(),
+      [](const std::string& strPath, const std::pair<const std::string, int>& Item) { return strPath == Item.first; }));
+}
+
+// run with --gtest_also_run_disabled_tests
+TEST_F(HelpersTest, DISABLED_BenchmarkSortPaths)
+{
+   const std::vector<std::string> vecPaths = GeneratePaths(1000000);
+
+   // the comparator as it was before the separators counts were precomputed
+   auto tStart = std::chrono::steady_clock::now();
+   std::map<std::string, int, LegacySlashOccurrencesComparison> mapLegacy;
+   for (const std::string& strPath : vecPaths)
+      mapLegacy.insert(std::make_pair(strPath, 0));
+   auto tLegacy = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - tStart);
+
+   tStart = std::chrono::steady_clock::now();
+   std::vector<std::string> vecSorted(vecPaths);
+   Directory::SortPaths(vecSorted);
+   auto tSorted = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - tStart);
+
+   std::cout << "[ BENCH    ] " << vecPaths.size() << " paths : legacy comparator map " << tLegacy.count()
+      << " ms, SortPaths " << tSorted.count() << " ms" << std::endl;
+
+   ASSERT_EQ(mapLegacy.size(), vecSorted.size());
+   EXPECT_TRUE(std::equal(vecSorted.cbegin(), vecSorted.cend(), mapLegacy.cbegin(),
+      [](const std::string& strPath, const std::pair<const std::string, int>& Item) { return strPath == Item.first; }));
+}
+
+TEST_F(HelpersTest, FlatSortedMap)
+{
+   typedef FlatSortedMap<std::string, std::string, Directory::SlashOccurrencesComparison> PathsMap;
+   std::vector<std::string> vecPaths = GeneratePaths(10000);
+   std::map<std::string, std::string, Directory::SlashOccurrencesComparison> mapExpected;
+   std::vector<PathsMap::value_type> vecPairs;
+   for (const std::string& strPath : vecPaths)
+   {
+      mapExpected.insert(std::make_pair(strPath, strPath + "_first"));
+      vecPairs.emplace_back(strPath, strPath + "_first");
+   }
+   for (const std::string& strPath : vecPaths)
+      vecPairs.emplace_back(strPath, strPath + "_second"); // duplicated keys : the first pair is kept
+
+   PathsMap mapFlat;
+   mapFlat.assign(std::move(vecPairs));
+
+   ASSERT_EQ(mapExpected.size(), mapFlat.size());
+   EXPECT_TRUE(std::equal(mapFlat.begin(), mapFlat.end(), mapExpected.cbegin(),
+      [](const PathsMap::value_type& Pair, const std::pair<const std::string, std::string>& Item)
+      { return Pair.first == Item.first && Pair.second == Item.second; }));
+
+   for (const std::string& strPath : vecPaths)
+   {
+      ASSERT_NE(mapFlat.end(), mapFlat.find(strPath));
+      EXPECT_EQ(strPath + "_first", mapFlat.at(strPath));
+   }
+   EXPECT_EQ(mapFlat.end(), mapFlat.find("inexistent/path"));
+   EXPECT_EQ(0, mapFlat.count("inexistent/path"));
+   EXPECT_THROW(mapFlat.at("inexistent/path"), std::out_of_range);
+
+   mapFlat.clear();
+   EXPECT_TRUE(mapFlat.empty());
+}
+
+// run with --gtest_also_run_disabled_tests
+TEST_F(HelpersTest, DISABLED_BenchmarkSortedMap)
+{
+   typedef FlatSortedMap<std::string, std::string, Directory::SlashOccurrencesComparison> PathsMap;
+   const std::vector<std::string> vecPaths = GeneratePaths(1000000);
+
+   typedef std::map<std::string, std::string, Directory::SlashOccurrencesComparison> NodeMap;
+   NodeMap mapNodes;
+   std::vector<PathsMap::value_type> vecPairs;
+   for (const std::string& strPath : vecPaths)
+   {
+      mapNodes.insert(std::make_pair(strPath, strPath));
+      vecPairs.emplace_back(strPath, strPath);
+   }
+   PathsMap mapFlat;
+   mapFlat.assign(std::move(vecPairs));
+   ASSERT_EQ(mapNodes.size(), mapFlat.size());
+
+   auto Measure = [](const std::function<size_t()>& Run, size_t& uResult)
+   {
+      const auto tStart = std::chrono::steady_clock::now();
+      uResult = Run();
+      return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - tStart).count();
+   };
+
+   // iteration
+   size_t uNodesLength = 0, uFlatLength = 0;
+   const auto tNodesIteration = Measure([&]()
+   {
+      size_t uLength = 0;
+      for (int i = 0; i < 10; ++i)
+         for (const auto& Pair : mapNodes)
+            uLength += Pair.first.length() + Pair.second.length();
+      return uLength;
+   }, uNodesLength);
+   const auto tFlatIteration = Measure([&]()
+   {
+      size_t uLength = 0;
+      for (int i = 0; i < 10; ++i)
+         for (const auto& Pair : mapFlat)
+            uLength += Pair.first.length() + Pair.second.length();
+      return uLength;
+   }, uFlatLength);
+   EXPECT_EQ(uNodesLength, uFlatLength);
+
+   // lookup (shuffled keys)
+   std::vector<std::string> vecKeys(vecPaths);
+   std::shuffle(vecKeys.begin(), vecKeys.end(), std::mt19937(42));
+   size_t uNodesFound = 0, uFlatFound = 0;
+   const auto tNodesLookup = Measure([&]()
+   {
+      size_t uFound = 0;
+      for (const std::string& strKey : vecKeys)
+         uFound += mapNodes.count(strKey);
+      return uFound;
+   }, uNodesFound);
+   const auto tFlatLookup = Measure([&]()
+   {
+      size_t uFound = 0;
+      for (const std::string& strKey : vecKeys)
+         uFound += mapFlat.count(strKey);
+      return uFound;
+   }, uFlatFound);
+   EXPECT_EQ(uNodesFound, uFlatFound);
+
+   // copy
+   size_t uNodesCopied = 0, uFlatCopied = 0;
+   const auto tNodesCopy = Measure([&]() { NodeMap mapCopy(mapNodes); return mapCopy.size(); }, uNodesCopied);
+   const auto tFlatCopy = Measure([&]() { PathsMap mapCopy(mapFlat); return mapCopy.size(); }, uFlatCopied);
+   EXPECT_EQ(uNodesCopied, uFlatCopied);
+
+   std::cout << "[ BENCH    ] " << mapFlat.size() << " paths, std::map / flat map : 10 iterations "
+      << tNodesIteration << " / " << tFlatIteration << " ms, lookups " << tNodesLookup << " / " << tFlatLookup
+      << " ms, copy " << tNodesCopy << " / " << tFlatCopy << " ms" << std::endl;
+}
+
+TEST_F(HelpersTest, FlatHashMap)
+{
+   const std::vector<std::string> vecPaths = GeneratePaths(10000);
+   std::unordered_map<std::string, std::string> mapExpected;
+   FlatHashMap mapFlat; // not reserved : grows while inserting
+   for (const std::string& strPath : vecPaths)
+   {
+      const bool bInserted = mapExpected.insert(std::make_pair(strPath, "/root/" + strPath)).second;
+      EXPECT_EQ(bInserted, mapFlat.insert(std::make_pair(strPath, "/root/" + strPath)).second);
+   }
+   EXPECT_FALSE(mapFlat.insert(std::make_pair(vecPaths.front(), std::string("other"))).second);
+
+   ASSERT_EQ(mapExpected.size(), mapFlat.size());
+   for (const auto& Pair : mapExpected)
+   {
+      auto itPath = mapFlat.find(Pair.first);
+      ASSERT_TRUE(itPath != mapFlat.end());
+      EXPECT_EQ(Pair.first, itPath->first);
+      EXPECT_EQ(Pair.second, itPath->second);
+      EXPECT_EQ(Pair.second, mapFlat.at(Pair.first).str());
+   }
+   size_t uIterated = 0;
+   for (const auto& Pair : mapFlat)
+   {
+      ++uIterated;
+      EXPECT_EQ(1, mapExpected.count(Pair.first));
+   }
+   EXPECT_EQ(mapExpected.size(), uIterated);
+
+   EXPECT_TRUE(mapFlat.find("inexistent/path") == mapFlat.end());
+   EXPECT_EQ(0, mapFlat.count(""));
+   EXPECT_THROW(mapFlat.at("inexistent/path"), std::out_of_range);
+
+   mapFlat.clear();
+   EXPECT_TRUE(mapFlat.empty());
+   EXPECT_TRUE(mapFlat.find(vecPaths.front()) == mapFlat.end());
+}
+
+// run with --gtest_also_run_disabled_tests
+TEST_F(HelpersTest, DISABLED_BenchmarkHashMap)
+{
+   const std::vector<std::string> vecPaths = GeneratePaths(1000000);
+   std::vector<std::string> vecKeys(vecPaths);
+   std::shuffle(vecKeys.begin(), vecKeys.end(), std::mt19937(42));
+
+   auto tStart = std::chrono::steady_clock::now();
+   std::unordered_map<std::string, std::string> mapNodes;
+   mapNodes.reserve(vecPaths.size());
+   for (const std::string& strPath : vecPaths)
+      mapNodes.insert(std::make_pair(strPath, strPath));
+   const auto tNodesBuild = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - tStart);
+
+   tStart = std::chrono::steady_clock::now();
+   FlatHashMap mapFlat;
+   mapFlat.reserve(vecPaths.size());
+   for (const std::string& strPath : vecPaths)
+      mapFlat.insert(strPath.data(), strPath.length(), strPath.data(), strPath.length());
+   const auto tFlatBuild = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - tStart);
+   ASSERT_EQ(mapNodes.size(), mapFlat.size());
+
+   size_t uNodesFound = 0;
+   tStart = std::chrono::steady_clock::now();
+   for (const std::string& strKey : vecKeys)
+      uNodesFound += mapNodes.count(strKey);
+   const auto tNodesLookup = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - tStart);
+
+   size_t uFlatFound = 0;
+   tStart = std::chrono::steady_clock::now();
+   for (const std::string& strKey : vecKeys)
+      uFlatFound += mapFlat.count(strKey);
+   const auto tFlatLookup = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - tStart);
+   EXPECT_EQ(uNodesFound, uFlatFound);
+
+   std::cout << "[ BENCH    ] " << mapFlat.size() << " paths, std::unordered_map / flat hash map : build "
+      << tNodesBuild.count() << " / " << tFlatBuild.count() << " ms, lookups " << tNodesLookup.count() << " / "
+      << tFlatLookup.count() << " ms" << std::endl;
+}
+
+TEST_F(HelpersTest, SnapshotDiff)
+{
+   const std::string strSnapshotFolder = TEST_FOLDER + "SNAPSHOT/";
+   ASSERT_TRUE(Directory::CreateDirectories(strSnapshotFolder + "A/B"));
+   std::ofstream(strSnapshotFolder + "root.txt") << "root";
+   std::ofstream(strSnapshotFolder + "A/a.txt") << "a";
+   std::ofstream(strSnapshotFolder + "A/B/b.txt") << "b";
+
+   DirectorySnapshot OldSnapshot;
+   ASSERT_TRUE(OldSnapshot.Capture(strSnapshotFolder));
+   EXPECT_EQ(5, OldSnapshot.GetEntries().size());
+   ASSERT_TRUE(OldSnapshot.Find("A/B/b.txt") != nullptr);
+   EXPECT_EQ(1, OldSnapshot.Find("A/B/b.txt")->uSize);
+
+   // nothing changed : the folders are taken from the previous snapshot
+   DirectorySnapshot NewSnapshot;
+   ASSERT_TRUE(NewSnapshot.Capture(strSnapshotFolder, &OldSnapshot));
+   #ifdef LINUX
+   EXPECT_EQ(2, NewSnapshot.GetReusedFoldersCount());
+   #endif
+   DirectorySnapshot::Changes NoChanges = DirectorySnapshot::Diff(OldSnapshot, NewSnapshot);
+   EXPECT_TRUE(NoChanges.vecAdded.empty() && NoChanges.vecRemoved.empty() && NoChanges.vecModified.empty());
+
+   std::ofstream(strSnapshotFolder + "A/B/new.txt") << "new";
+   std::ofstream(strSnapshotFolder + "root.txt", std::ofstream::app) << " grows";
+   ASSERT_TRUE(Directory::EraseFile(strSnapshotFolder + "A/a.txt"));
+
+   ASSERT_TRUE(NewSnapshot.Capture(strSnapshotFolder, &OldSnapshot));
+   DirectorySnapshot::Changes SomeChanges = DirectorySnapshot::Diff(OldSnapshot, NewSnapshot);
+   EXPECT_EQ(std::vector<std::string>{ "A/B/new.txt" }, SomeChanges.vecAdded);
+   EXPECT_EQ(std::vector<std::string>{ "A/a.txt" }, SomeChanges.vecRemoved);
+   EXPECT_EQ(std::vector<std::string>{ "root.txt" }, SomeChanges.vecModified);
+
+   // changes two levels down : A's mtime doesn't change, A/B is checked anyway
+   ASSERT_TRUE(OldSnapshot.Capture(strSnapshotFolder));
+   std::ofstream(strSnapshotFolder + "A/B/deep.txt") << "deep";
+   std::ofstream(strSnapshotFolder + "A/B/b.tmp") << "replaced";
+   ASSERT_TRUE(Directory::Rename(strSnapshotFolder + "A/B/b.tmp", strSnapshotFolder + "A/B/b.txt"));
+   ASSERT_TRUE(NewSnapshot.Capture(strSnapshotFolder, &OldSnapshot));
+   #ifdef LINUX
+   EXPECT_EQ(1, NewSnapshot.GetReusedFoldersCount()); // A
+   #endif
+   SomeChanges = DirectorySnapshot::Diff(OldSnapshot, NewSnapshot);
+   EXPECT_EQ(std::vector<std::string>{ "A/B/deep.txt" }, SomeChanges.vecAdded);
+   EXPECT_TRUE(SomeChanges.vecRemoved.empty());
+   EXPECT_EQ(std::vector<std::string>{ "A/B/b.txt" }, SomeChanges.vecModified);
+
+   DirectorySnapshot FullSnapshot;
+   ASSERT_TRUE(FullSnapshot.Capture(strSnapshotFolder));
+   DirectorySnapshot::Changes SameChanges = DirectorySnapshot::Diff(NewSnapshot, FullSnapshot);
+   EXPECT_TRUE(SameChanges.vecAdded.empty() && SameChanges.vecRemoved.empty() && SameChanges.vecModified.empty());
+
+   bool bSuccess = false;
+   Directory::EraseFolder(strSnapshotFolder, bSuccess);
+   EXPECT_TRUE(bSuccess);
+
+   // check for failure
+   EXPECT_FALSE(NewSnapshot.Capture(strSnapshotFolder));
+}
+
+TEST_F(HelpersTest, DiskUsage)
+{
+   const std::string strUsageFolder = TEST_FOLDER + "USAGE/";
+   ASSERT_TRUE(Directory::CreateDirectories(strUsageFolder + "A/B"));
+   ASSERT_TRUE(Directory::CreateDirectories(strUsageFolder + "C"));
+   std::ofstream(strUsageFolder + "root.txt") << std::string(100, 'r');
+   std::ofstream(strUsageFolder + "A/a.txt") << std::string(10, 'a');
+   std::ofstream(strUsageFolder + "A/B/b.txt") << std::string(1000, 'b');
+
+   Directory UsageDir;
+   UsageDir.ListFolders(strUsageFolder, true);
+
+   Directory::DiskUsageOptions Options;
+   Directory::DiskUsageResult Result;
+   ASSERT_TRUE(Directory::DiskUsage(strUsageFolder, Options, Result));
+   EXPECT_EQ(3, Result.Total.uFiles);
+   EXPECT_EQ(3, Result.Total.uFolders);
+   EXPECT_EQ(0, Result.uErrors);
+
+   // same keys as the sorted folders map, in the same order
+   ASSERT_EQ(UsageDir.GetMapSortedFoldersRelAbs().size(), Result.mapFolders.size());
+   EXPECT_TRUE(std::equal(Result.mapFolders.begin(), Result.mapFolders.end(), UsageDir.GetMapSortedFoldersRelAbs().begin(),
+      [](const std::pair<std::string, Directory::FolderUsage>& Usage, const Directory::SortedMap::value_type& Folder)
+      { return Usage.first == Folder.first; }));
+
+   // sizes summed bottom-up (the folders' own sizes are counted too)
+   const Directory::FolderUsage& UsageA = Result.mapFolders.at("A");
+   const Directory::FolderUsage& UsageB = Result.mapFolders.at("A/B");
+   EXPECT_EQ(2, UsageA.uFiles);
+   EXPECT_EQ(1, UsageA.uFolders);
+   EXPECT_LE(1000, UsageB.uApparentSize);
+   EXPECT_LE(UsageB.uApparentSize + 10, UsageA.uApparentSize);
+   EXPECT_LE(UsageA.uApparentSize + 100, Result.Total.uApparentSize);
+
+   #ifdef LINUX
+   // a second link to a file isn't counted again, a symbolic link isn't followed
+   ASSERT_EQ(0, link((strUsageFolder + "A/B/b.txt").c_str(), (strUsageFolder + "C/b_link.txt").c_str()));
+   fs::create_symlink(strUsageFolder + "A/B/b.txt", strUsageFolder + "C/b_symlink.txt");
+   for (size_t uThreads : { 1, 4 })
+   {
+      Options.uThreads = uThreads;
+      Directory::DiskUsageResult LinkedResult;
+      ASSERT_TRUE(Directory::DiskUsage(strUsageFolder, Options, LinkedResult));
+      EXPECT_EQ(4, LinkedResult.Total.uFiles);
+      EXPECT_GT(Result.Total.uApparentSize + 1000, LinkedResult.Total.uApparentSize);
+   }
+   #endif
+
+   // only the first level
+   Options.uMaxDepth = 1;
+   ASSERT_TRUE(Directory::DiskUsage(strUsageFolder, Options, Result));
+   EXPECT_EQ(2, Result.mapFolders.size());
+
+   bool bSuccess = false;
+   Directory::EraseFolder(strUsageFolder, bSuccess);
+   EXPECT_TRUE(bSuccess);
+
+   // check for failure
+   EXPECT_FALSE(Directory::DiskUsage(strUsageFolder, Options, Result));
+}
+
+TEST_F(HelpersTest, SaveAndLoadIndex)
+{
+   const std::string strIndexedFolder = TEST_FOLDER + "INDEXED/";
+   const std::string strIndexFile = TEST_FOLDER + "listing.idx";
+   ASSERT_TRUE(Directory::CreateDirectories(strIndexedFolder + "A/B"));
+   ASSERT_TRUE(Directory::CreateDirectories(strIndexedFolder + "C"));
+   std::ofstream(strIndexedFolder + "root.txt") << "root";
+   std::ofstream(strIndexedFolder + "A/a.txt") << "a";
+   std::ofstream(strIndexedFolder + "A/B/b.txt") << "bb";
+   fs::last_write_time(strIndexedFolder + "C", std::time(nullptr) - 100); // any change will be seen
+
+   Directory IndexedDir;
+   EXPECT_FALSE(IndexedDir.SaveIndex(strIndexFile)); // nothing listed
+   IndexedDir.SetMetadataCollection(true);
+   IndexedDir.ListFiles(strIndexedFolder, true);
+   ASSERT_TRUE(IndexedDir.SaveIndex(strIndexFile));
+
+   DirectoryIndex Index;
+   ASSERT_TRUE(Index.Open(strIndexFile));
+   EXPECT_TRUE(Index.Validate());
+   EXPECT_TRUE(Index.IsRecursive());
+   ASSERT_EQ(3, Index.GetFilesCount());
+   EXPECT_EQ(0, Index.GetFoldersCount());
+   ASSERT_TRUE(Index.HasMetadata());
+
+   size_t uIndex = 0;
+   ASSERT_TRUE(Index.FindFile("A/B/b.txt", uIndex));
+   EXPECT_EQ(2, Index.GetFileSize(uIndex));
+   EXPECT_EQ(IndexedDir.GetFiles().GetAbsolutePath(uIndex), std::string(Index.GetFilesRoot()) + Index.GetFileRelativePath(uIndex));
+   EXPECT_FALSE(Index.FindFile("A/B", uIndex));
+
+   // same tables and maps as the listing
+   Directory LoadedDir;
+   ASSERT_TRUE(LoadedDir.LoadIndex(Index));
+   EXPECT_TRUE(IndexedDir.GetMapSortedFilesRelAbs() == LoadedDir.GetMapSortedFilesRelAbs());
+   EXPECT_TRUE(IndexedDir.GetMapFilesAbsRel() == LoadedDir.GetMapFilesAbsRel());
+   EXPECT_EQ(7, LoadedDir.GetFilesMetadata().GetTotalSize());
+
+   // an entry added in an empty folder : only the index of this subtree is stale
+   std::ofstream(strIndexedFolder + "C/c.txt") << "c";
+   EXPECT_FALSE(Index.Validate());
+   EXPECT_FALSE(Index.ValidateFolder(strIndexedFolder + "C"));
+   EXPECT_TRUE(Index.ValidateFolder(strIndexedFolder + "A"));
+   Index.Close();
+
+   // a path offset out of the string pool : the header is valid, the entries aren't
+   std::string strIndexData;
+   {
+      std::ifstream ifsIndex(strIndexFile, std::ifstream::binary);
+      strIndexData.assign(std::istreambuf_iterator<char>(ifsIndex), std::istreambuf_iterator<char>());
+   }
+   const size_t uFilesPathsField = 112; // Header::Files.uPaths
+   uint64_t uFilesPaths = 0;
+   ASSERT_LT(uFilesPathsField + sizeof(uint64_t), strIndexData.size());
+   memcpy(&uFilesPaths, &strIndexData[uFilesPathsField], sizeof(uint64_t));
+   ASSERT_LT(uFilesPaths + sizeof(uint64_t), strIndexData.size());
+   const uint64_t uOutOfPool = strIndexData.size();
+   memcpy(&strIndexData[uFilesPaths], &uOutOfPool, sizeof(uint64_t));
+   std::ofstream(strIndexFile + ".bad", std::ofstream::binary | std::ofstream::trunc) << strIndexData;
+   EXPECT_FALSE(Index.Open(strIndexFile + ".bad"));
+   EXPECT_FALSE(Index.IsOpen());
+   EXPECT_TRUE(Directory::EraseFile(strIndexFile + ".bad"));
+
+   // check for failure
+   std::ofstream(strIndexFile, std::ofstream::trunc) << "not an index, but long enough to hold the header of one, "
+      "not an index, but long enough to hold the header of one, not an index, but long enough to hold the header";
+   EXPECT_FALSE(Index.Open(strIndexFile));
+   EXPECT_FALSE(Index.Open(TEST_FOLDER + "inexistant.idx"));
+
+   bool bSuccess = false;
+   Directory::EraseFolder(strIndexedFolder, bSuccess);
+   EXPECT_TRUE(bSuccess);
+   EXPECT_TRUE(Directory::EraseFile(strIndexFile));
+}
+
+TEST_F(HelpersTest, StatMany)
+{
+   const std::string strStatFolder = TEST_FOLDER + "STAT_MANY/";
+   ASSERT_TRUE(Directory::CreateDirectories(strStatFolder));
+
+   // more paths than requests in flight at once
+   std::vector<std::string> vecPaths;
+   for (size_t uFile = 0; uFile < 600; ++uFile)
+   {
+      vecPaths.push_back(strStatFolder + "file_" + std::to_string(uFile) + ".txt");
+      if (uFile % 3 != 0)
+         std::ofstream(vecPaths.back()) << std::string(uFile, 'x');
+   }
+   vecPaths.push_back(strStatFolder);
+
+   const std::vector<Directory::PathStatus> vecStatus = Directory::StatMany(vecPaths);
+   ASSERT_EQ(vecPaths.size(), vecStatus.size());
+   for (size_t uFile = 0; uFile < 600; ++uFile)
+   {
+      EXPECT_EQ(uFile % 3 != 0, vecStatus[uFile].bExists) << vecPaths[uFile];
+      if (vecStatus[uFile].bExists)
+      {
+         EXPECT_EQ(Directory::FILE_ENTRY, vecStatus[uFile].eType);
+         EXPECT_EQ(uFile, vecStatus[uFile].Metadata.uSize);
+         EXPECT_EQ(Directory::GetLastWriteTime(vecPaths[uFile]), vecStatus[uFile].Metadata.tModificationTime);
+      }
+   }
+   EXPECT_TRUE(vecStatus.back().bExists);
+   EXPECT_EQ(Directory::FOLDER_ENTRY, vecStatus.back().eType);
+
+   EXPECT_TRUE(Directory::StatMany(std::vector<std::string>()).empty());
+
+   bool bSuccess = false;
+   Directory::EraseFolder(strStatFolder, bSuccess);
+   EXPECT_TRUE(bSuccess);
+}
+
+TEST_F(HelpersTest, StatManyRingFailure)
+{
+   const std::string strStatFolder = TEST_FOLDER + "STAT_MANY_FAILURE/";
+   ASSERT_TRUE(Directory::CreateDirectories(strStatFolder));
+
+   std::vector<std::string> vecPaths;
+   for (size_t uFile = 0; uFile < 300; ++uFile)
+   {
+      vecPaths.push_back(strStatFolder + "file_" + std::to_string(uFile) + ".txt");
+      std::ofstream(vecPaths.back()) << std::string(uFile, 'x');
+   }
+
+   // a hard failure once the requests are in flight : they are reaped before the fallback,
+   // a transient one is retried
+   for (const int iErrno : { EIO, EAGAIN, EINTR })
+   {
+      Directory::InjectStatManyFailure(iErrno);
+      const std::vector<Directory::PathStatus> vecStatus = Directory::StatMany(vecPaths);
+      ASSERT_EQ(vecPaths.size(), vecStatus.size());
+      for (size_t uFile = 0; uFile < vecPaths.size(); ++uFile)
+      {
+         EXPECT_TRUE(vecStatus[uFile].bExists) << vecPaths[uFile] << " " << iErrno;
+         EXPECT_EQ(uFile, vecStatus[uFile].Metadata.uSize) << vecPaths[uFile] << " " << iErrno;
+      }
+   }
+   Directory::InjectStatManyFailure(0);
+
+   bool bSuccess = false;
+   Directory::EraseFolder(strStatFolder, bSuccess);
+   EXPECT_TRUE(bSuccess);
+}
+
+TEST_F(HelpersTest, DISABLED_BenchmarkStatMany)
+{
+   const std::string strBenchFolder = TEST_FOLDER + "BENCH_STAT/";
+   std::vector<std::string> vecPaths;
+   for (size_t uFolder = 0; uFolder < 100; ++uFolder)
+   {
+      const std::string strFolder = strBenchFolder + std::to_string(uFolder) + "/";
+      ASSERT_TRUE(Directory::CreateDirectories(strFolder));
+      for (size_t uFile = 0; uFile < 500; ++uFile)
+      {
+         vecPaths.push_back(strFolder + "file_" + std::to_string(uFile) + ".txt");
+         std::ofstream ofsDummy(vecPaths.back());
+      }
+   }
+
+   // drop the page cache before each run (needs root) to measure cold lookups
+   auto tStart = std::chrono::steady_clock::now();
+   size_t uSize = 0;
+   for (const std::string& strPath : vecPaths)
+   {
+      bool bSuccess = false;
+      if (Directory::IsFile(strPath))
+         uSize += Directory::FileSize(strPath, bSuccess) + (Directory::GetLastWriteTime(strPath) > 0);
+   }
+   auto tElapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - tStart);
+   std::cout << "[ BENCH    ] one by one : " << vecPaths.size() << " paths in " << tElapsed.count() << " ms" << std::endl;
+
+   tStart = std::chrono::steady_clock::now();
+   size_t uExisting = 0;
+   for (const Directory::PathStatus& Status : Directory::StatMany(vecPaths))
+      uExisting += Status.bExists;
+   tElapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - tStart);
+   std::cout << "[ BENCH    ] StatMany : " << vecPaths.size() << " paths in " << tElapsed.count() << " ms" << std::endl;
+   EXPECT_EQ(vecPaths.size(), uExisting);
+
+   bool bSuccess = false;
+   Directory::EraseFolder(strBenchFolder, bSuccess);
+   EXPECT_TRUE(bSuccess);
+}
+
+TEST_F(HelpersTest, MetadataListing)
+{
+   const std::string strMetadataFolder = TEST_FOLDER + "METADATA";
+   ASSERT_TRUE(Directory::CreateDirectories(strMetadataFolder + "/A"));
+   std::ofstream(strMetadataFolder + "/A/ten.txt") << "0123456789";
+   std::ofstream(strMetadataFolder + "/old.txt") << "old";
+   const std::time_t tOld = std::time(nullptr) - 10 * 86400;
+   fs::last_write_time(strMetadataFolder + "/old.txt", tOld);
+
+   Directory MetadataDir;
+   MetadataDir.ListFiles(strMetadataFolder, true);
+   EXPECT_EQ(0, MetadataDir.GetFilesMetadata().Size()); // not collected by default
+
+   MetadataDir.SetMetadataCollection(true);
+   for (size_t uThreads : { 1, 4 })
+   {
+      MetadataDir.SetThreadsCount(uThreads);
+      MetadataDir.ListTree(strMetadataFolder, true);
+      const Directory::EntryTable& Files = MetadataDir.GetFiles();
+      const Directory::MetadataTable& Metadata = MetadataDir.GetFilesMetadata();
+      ASSERT_EQ(2, Metadata.Size());
+      EXPECT_EQ(1, MetadataDir.GetFoldersMetadata().Size());
+      EXPECT_EQ(13, Metadata.GetTotalSize());
+      for (size_t uIndex = 0; uIndex < Files.Size(); ++uIndex)
+      {
+         bool bSuccess = false;
+         EXPECT_EQ(Directory::FileSize(Files.GetAbsolutePath(uIndex), bSuccess), Metadata.GetSize(uIndex));
+         EXPECT_EQ(Directory::GetLastWriteTime(Files.GetAbsolutePath(uIndex)), Metadata.GetModificationTime(uIndex));
+         #ifdef LINUX
+         EXPECT_TRUE(S_ISREG(Metadata.GetMode(uIndex)));
+         EXPECT_NE(0, Metadata.GetInode(uIndex));
+         #endif
+      }
+   }
+
+   // only old.txt is older than 5 days
+   EXPECT_EQ(1, Directory::CleanUpFiles(strMetadataFolder, 5, true));
+   EXPECT_FALSE(Directory::IsFile(strMetadataFolder + "/old.txt"));
+   EXPECT_TRUE(Directory::IsFile(strMetadataFolder + "/A/ten.txt"));
+
+   bool bSuccess = false;
+   Directory::EraseFolder(strMetadataFolder, bSuccess);
+   EXPECT_TRUE(bSuccess);
+}
+
+TEST_F(HelpersTest, StreamingCleanUp)
+{
+   const std::string strCleanUpFolder = TEST_FOLDER + "CLEANUP_STREAMING";
+   // the same tree twice : the streaming mode deletes the same files as the listing one
+   for (const char* pszSuffix : { "", "_LISTED" })
+   {
+      for (size_t uFolder = 0; uFolder < 4; ++uFolder)
+      {
+         const std::string strFolder = strCleanUpFolder + pszSuffix + "/" + std::to_string(uFolder) + "/sub";
+         ASSERT_TRUE(Directory::CreateDirectories(strFolder));
+         for (size_t uFile = 0; uFile < 10; ++uFile)
+         {
+            const std::string strFile = strFolder + ((uFile % 2) ? "/../" : "/") + "file_" + std::to_string(uFile) + ".txt";
+            std::ofstream(strFile) << "file";
+            if (uFile < 6)
+               fs::last_write_time(strFile, std::time(nullptr) - (3 + uFile) * 86400);
+         }
+      }
+      std::ofstream(strCleanUpFolder + pszSuffix + "/root_old.txt") << "old";
+      fs::last_write_time(strCleanUpFolder + pszSuffix + "/root_old.txt", std::time(nullptr) - 30 * 86400);
+   }
+
+   Directory::CleanUpOptions Options;
+   Options.bStreaming = true;
+   EXPECT_EQ(1, Directory::CleanUpFiles(strCleanUpFolder, 5, Options)); // only the root's files
+   EXPECT_EQ(1, Directory::CleanUpFiles(strCleanUpFolder + "_LISTED", 5, false));
+
+   // older than 5 days : file_3, file_4 and file_5 of each folder
+   Options.bRecursive = true;
+   EXPECT_EQ(12, Directory::CleanUpFiles(strCleanUpFolder, 5, Options));
+   EXPECT_EQ(12, Directory::CleanUpFiles(strCleanUpFolder + "_LISTED", 5, true));
+   EXPECT_FALSE(Directory::IsFile(strCleanUpFolder + "/0/sub/file_4.txt"));
+   EXPECT_FALSE(Directory::IsFile(strCleanUpFolder + "/0/file_5.txt"));
+   EXPECT_TRUE(Directory::IsFile(strCleanUpFolder + "/0/file_1.txt"));
+
+   Directory Remaining;
+   Remaining.ListFiles(strCleanUpFolder, true);
+   Directory RemainingListed;
+   RemainingListed.ListFiles(strCleanUpFolder + "_LISTED", true);
+   EXPECT_EQ(28, Remaining.GetFilesCount());
+   EXPECT_TRUE(Remaining.GetMapSortedFilesRelAbs().size() == RemainingListed.GetMapSortedFilesRelAbs().size()
+      && std::equal(Remaining.GetMapSortedFilesRelAbs().begin(), Remaining.GetMapSortedFilesRelAbs().end(),
+         RemainingListed.GetMapSortedFilesRelAbs().begin(),
+         [](const Directory::SortedMap::value_type& A, const Directory::SortedMap::value_type& B)
+         { return A.first == B.first; }));
+
+   // check for failure
+   EXPECT_EQ(0, Directory::CleanUpFiles(TEST_FOLDER + "Inexistent_Folder", 1, Options));
+
+   bool bSuccess = false;
+   Directory::EraseFolder(strCleanUpFolder, bSuccess);
+   EXPECT_TRUE(bSuccess);
+   Directory::EraseFolder(strCleanUpFolder + "_LISTED", bSuccess);
+   EXPECT_TRUE(bSuccess);
+}
+
+TEST_F(HelpersTest, ParallelCleanUp)
+{
+   const std::string strCleanUpFolder = TEST_FOLDER + "CLEANUP_PARALLEL";
+   const std::string strOutsideFolder = TEST_FOLDER + "CLEANUP_PARALLEL_OUTSIDE";
+   ASSERT_TRUE(Directory::CreateDirectories(strOutsideFolder));
+   std::ofstream(strOutsideFolder + "/old.txt") << "old";
+   fs::last_write_time(strOutsideFolder + "/old.txt", std::time(nullptr) - 30 * 86400);
+
+   // the same tree twice : the parallel clean up deletes the same files as the listing one
+   for (const char* pszSuffix : { "", "_LISTED" })
+   {
+      for (size_t uFolder = 0; uFolder < 16; ++uFolder)
+      {
+         const std::string strFolder = strCleanUpFolder + pszSuffix + "/" + std::to_string(uFolder % 4) + "/"
+            + std::to_string(uFolder);
+         ASSERT_TRUE(Directory::CreateDirectories(strFolder));
+         for (size_t uFile = 0; uFile < 20; ++uFile)
+         {
+            const std::string strFile = strFolder + "/file_" + std::to_string(uFile) + ".txt";
+            std::ofstream(strFile) << "file";
+            if (uFile % 3 == 0)
+               fs::last_write_time(strFile, std::time(nullptr) - 10 * 86400);
+         }
+      }
+      // a link to an expired file is deleted (not its target), a link to a folder isn't followed
+      fs::create_symlink(strOutsideFolder + "/old.txt", strCleanUpFolder + pszSuffix + "/old_link.txt");
+      fs::create_directory_symlink(strOutsideFolder, strCleanUpFolder + pszSuffix + "/0/folder_link");
+   }
+
+   Directory::CleanUpOptions Options;
+   Options.bRecursive = true;
+   Options.uThreads = 4;
+   const size_t uExpected = Directory::CleanUpFiles(strCleanUpFolder + "_LISTED", 5, true);
+   EXPECT_EQ(16 * 7 + 1, uExpected);
+   EXPECT_EQ(uExpected, Directory::CleanUpFiles(strCleanUpFolder, 5, Options));
+   EXPECT_TRUE(Directory::IsFile(strOutsideFolder + "/old.txt"));
+   EXPECT_FALSE(fs::exists(fs::symlink_status(strCleanUpFolder + "/old_link.txt")));
+
+   Directory Remaining;
+   Remaining.ListFiles(strCleanUpFolder, true);
+   Directory RemainingListed;
+   RemainingListed.ListFiles(strCleanUpFolder + "_LISTED", true);
+   EXPECT_EQ(16 * 13, Remaining.GetFilesCount());
+   EXPECT_TRUE(Remaining.GetMapSortedFilesRelAbs().size() == RemainingListed.GetMapSortedFilesRelAbs().size()
+      && std::equal(Remaining.GetMapSortedFilesRelAbs().begin(), Remaining.GetMapSortedFilesRelAbs().end(),
+         RemainingListed.GetMapSortedFilesRelAbs().begin(),
+         [](const Directory::SortedMap::value_type& A, const Directory::SortedMap::value_type& B)
+         { return A.first == B.first; }));
+
+   // nothing left to delete, only the root's files without recursion
+   EXPECT_EQ(0, Directory::CleanUpFiles(strCleanUpFolder, 5, Options));
+   std::ofstream(strCleanUpFolder + "/root_old.txt") << "old";
+   fs::last_write_time(strCleanUpFolder + "/root_old.txt", std::time(nullptr) - 30 * 86400);
+   fs::last_write_time(strCleanUpFolder + "/0/0/file_1.txt", std::time(nullptr) - 30 * 86400);
+   Options.bRecursive = false;
+   EXPECT_EQ(1, Directory::CleanUpFiles(strCleanUpFolder, 5, Options));
+   EXPECT_TRUE(Directory::IsFile(strCleanUpFolder + "/0/0/file_1.txt"));
+
+   bool bSuccess = false;
+   for (const std::string& strFolder : { strCleanUpFolder, strCleanUpFolder + "_LISTED", strOutsideFolder })
+   {
+      Directory::EraseFolder(strFolder, bSuccess);
+      EXPECT_TRUE(bSuccess);
+   }
+}
+
+TEST_F(HelpersTest, RetentionPolicies)
+{
+   const std::string strRetentionFolder = TEST_FOLDER + "RETENTION";
+   const std::vector<std::string> vecFolders = { "", "/A", "/A/C", "/B" };
+   // 4 files of 100 bytes per folder, the deeper ones are older : folder i has files 10 * i + 1 to 10 * i + 4 days old
+   auto CreateTree = [&]()
+   {
+      for (size_t uFolder = 0; uFolder < vecFolders.size(); ++uFolder)
+      {
+         ASSERT_TRUE(Directory::CreateDirectories(strRetentionFolder + vecFolders[uFolder]));
+         for (size_t uFile = 0; uFile < 4; ++uFile)
+         {
+            const std::string strFile = strRetentionFolder + vecFolders[uFolder] + "/f" + std::to_string(uFile);
+            std::ofstream(strFile) << std::string(100, 'f');
+            fs::last_write_time(strFile, std::time(nullptr) - (10 * uFolder + uFile + 1) * 86400);
+         }
+      }
+   };
+
+   for (size_t uThreads : { 1, 4 })
+   {
+      Directory::CleanUpOptions Options;
+      Options.bRecursive = true;
+      Options.uThreads = uThreads;
+      CreateTree();
+
+      // nothing to do by default
+      Directory::RetentionPolicy Policy;
+      EXPECT_EQ(0, Directory::ApplyRetention(strRetentionFolder, Policy, Options));
+
+      // the 2 newest files of each folder are kept
+      Policy.uKeepPerFolder = 2;
+      EXPECT_EQ(8, Directory::ApplyRetention(strRetentionFolder, Policy, Options));
+      for (const std::string& strFolder : vecFolders)
+      {
+         EXPECT_TRUE(Directory::IsFile(strRetentionFolder + strFolder + "/f1"));
+         EXPECT_FALSE(Directory::IsFile(strRetentionFolder + strFolder + "/f2"));
+      }
+
+      // 800 bytes left : the 3 oldest files are deleted to fit in 500 bytes
+      Policy.uKeepPerFolder = SIZE_MAX;
+      Policy.uMaxTotalSize = 500;
+      EXPECT_EQ(3, Directory::ApplyRetention(strRetentionFolder, Policy, Options));
+      EXPECT_FALSE(Directory::IsFile(strRetentionFolder + "/B/f0"));
+      EXPECT_FALSE(Directory::IsFile(strRetentionFolder + "/A/C/f1"));
+      EXPECT_TRUE(Directory::IsFile(strRetentionFolder + "/A/C/f0"));
+      EXPECT_EQ(0, Directory::ApplyRetention(strRetentionFolder, Policy, Options));
+
+      bool bSuccess = false;
+      Directory::EraseFolder(strRetentionFolder, bSuccess);
+      ASSERT_TRUE(bSuccess);
+      CreateTree();
+
+      // the criteria are combined : older than 15 days (A/C and B), then 3 files per folder, then the quota
+      Policy.uMaxAgeDays = 15;
+      Policy.uKeepPerFolder = 3;
+      Policy.uMaxTotalSize = 550;
+      EXPECT_EQ(8 + 2 + 1, Directory::ApplyRetention(strRetentionFolder, Policy, Options));
+      EXPECT_FALSE(Directory::IsFile(strRetentionFolder + "/A/f2"));
+      EXPECT_TRUE(Directory::IsFile(strRetentionFolder + "/A/f1"));
+      EXPECT_TRUE(Directory::IsFile(strRetentionFolder + "/f2"));
+
+      // without recursion, only the root's files
+      Policy = Directory::RetentionPolicy();
+      Policy.uKeepPerFolder = 1;
+      Options.bRecursive = false;
+      EXPECT_EQ(2, Directory::ApplyRetention(strRetentionFolder, Policy, Options));
+      EXPECT_TRUE(Directory::IsFile(strRetentionFolder + "/f0"));
+      EXPECT_TRUE(Directory::IsFile(strRetentionFolder + "/A/f1"));
+
+      Directory::EraseFolder(strRetentionFolder, bSuccess);
+      ASSERT_TRUE(bSuccess);
+
+      // the quota compares the files of all the folders : the oldest one (b/X) goes first, even if the walk
+      // reads a/ before and deleting a/Y alone would fit in
+      ASSERT_TRUE(Directory::CreateDirectories(strRetentionFolder + "/a"));
+      ASSERT_TRUE(Directory::CreateDirectories(strRetentionFolder + "/b"));
+      std::ofstream(strRetentionFolder + "/a/Y") << std::string(8, 'y');
+      std::ofstream(strRetentionFolder + "/a/Z") << std::string(5, 'z');
+      std::ofstream(strRetentionFolder + "/b/X") << "x";
+      const std::time_t tOldest = std::time(nullptr) - 30 * 86400;
+      fs::last_write_time(strRetentionFolder + "/b/X", tOldest);
+      fs::last_write_time(strRetentionFolder + "/a/Y", tOldest + 86400);
+      fs::last_write_time(strRetentionFolder + "/a/Z", tOldest + 2 * 86400);
+      Policy = Directory::RetentionPolicy();
+      Policy.uMaxTotalSize = 10;
+      Options.bRecursive = true;
+      Options.bPruneEmptyFolders = true;
+      EXPECT_EQ(2, Directory::ApplyRetention(strRetentionFolder, Policy, Options));
+      EXPECT_FALSE(Directory::IsFile(strRetentionFolder + "/b/X"));
+      EXPECT_FALSE(Directory::IsFile(strRetentionFolder + "/a/Y"));
+      EXPECT_TRUE(Directory::IsFile(strRetentionFolder + "/a/Z"));
+      // emptied by the quota
+      EXPECT_FALSE(Directory::IsDirectory(strRetentionFolder + "/b"));
+
+      Directory::EraseFolder(strRetentionFolder, bSuccess);
+      ASSERT_TRUE(bSuccess);
+   }
+
+   #ifdef LINUX
+   // more folders than descriptors kept for the quota (half of the limit) : the others are opened again
+   for (size_t uFolder = 0; uFolder < 100; ++uFolder)
+   {
+      const std::string strFolder = strRetentionFolder + "/F" + std::to_string(uFolder);
+      ASSERT_TRUE(Directory::CreateDirectories(strFolder));
+      std::ofstream(strFolder + "/f") << std::string(10, 'f');
+      fs::last_write_time(strFolder + "/f", std::time(nullptr) - (200 - uFolder) * 86400);
+   }
+   struct rlimit Limit;
+   ASSERT_EQ(0, getrlimit(RLIMIT_NOFILE, &Limit));
+   struct rlimit Lowered = Limit;
+   Lowered.rlim_cur = 64;
+   ASSERT_EQ(0, setrlimit(RLIMIT_NOFILE, &Lowered));
+   Directory::RetentionPolicy Policy;
+   Policy.uMaxTotalSize = 500;
+   Directory::CleanUpOptions Options;
+   Options.bRecursive = true;
+   Options.bPruneEmptyFolders = true;
+   Options.uThreads = 4;
+   EXPECT_EQ(50, Directory::ApplyRetention(strRetentionFolder, Policy, Options));
+   ASSERT_EQ(0, setrlimit(RLIMIT_NOFILE, &Limit));
+   for (size_t uFolder = 0; uFolder < 100; ++uFolder)
+      EXPECT_EQ(uFolder >= 50, Directory::IsDirectory(strRetentionFolder + "/F" + std::to_string(uFolder))) << uFolder;
+
+   bool bSuccess = false;
+   Directory::EraseFolder(strRetentionFolder, bSuccess);
+   ASSERT_TRUE(bSuccess);
+   #endif
+
+   // check for failure
+   EXPECT_EQ(0, Directory::ApplyRetention(TEST_FOLDER + "Inexistent_Folder", Directory::RetentionPolicy()));
+}
+
+TEST_F(HelpersTest, PruneEmptyFolders)
+{
+   const std::string strPruneFolder = TEST_FOLDER + "PRUNE";
+   // A/B/C and D/E only have expired files, D keeps a recent one, F is already empty
+   auto CreateTree = [&]()
+   {
+      ASSERT_TRUE(Directory::CreateDirectories(strPruneFolder + "/A/B/C"));
+      ASSERT_TRUE(Directory::CreateDirectories(strPruneFolder + "/D/E"));
+      ASSERT_TRUE(Directory::CreateDirectories(strPruneFolder + "/F"));
+      for (const char* pszFile : { "/old.txt", "/A/old.txt", "/A/B/C/old.txt", "/D/E/old.txt", "/D/old.txt" })
+      {
+         std::ofstream(strPruneFolder + pszFile) << "old";
+         fs::last_write_time(strPruneFolder + pszFile, std::time(nullptr) - 30 * 86400);
+      }
+      std::ofstream(strPruneFolder + "/D/new.txt") << "new";
+   };
+
+   // 0 : files listed then deleted, 1 : streaming, 2 : parallel, 3 : retention policy
+   for (size_t uMode = 0; uMode < 4; ++uMode)
+   {
+      CreateTree();
+      Directory::CleanUpOptions Options;
+      Options.bPruneEmptyFolders = true;
+      Options.bStreaming = (uMode == 1);
+      Options.uThreads = (uMode == 2) ? 4 : 1;
+
+      // without recursion, nothing is pruned
+      EXPECT_EQ(1, Directory::CleanUpFiles(strPruneFolder, 5, Options));
+      EXPECT_TRUE(Directory::IsDirectory(strPruneFolder + "/F"));
+
+      Options.bRecursive = true;
+      Directory::RetentionPolicy Policy;
+      Policy.uMaxAgeDays = 5;
+      EXPECT_EQ(4, (uMode == 3) ? Directory::ApplyRetention(strPruneFolder, Policy, Options)
+         : Directory::CleanUpFiles(strPruneFolder, 5, Options));
+      EXPECT_FALSE(Directory::IsDirectory(strPruneFolder + "/A"));
+      EXPECT_FALSE(Directory::IsDirectory(strPruneFolder + "/D/E"));
+      EXPECT_TRUE(Directory::IsFile(strPruneFolder + "/D/new.txt"));
+      // only the folders emptied by the clean-up are removed
+      EXPECT_TRUE(Directory::IsDirectory(strPruneFolder + "/F"));
+
+      // D is emptied, the root is kept
+      ASSERT_TRUE(fs::remove(strPruneFolder + "/F"));
+      fs::last_write_time(strPruneFolder + "/D/new.txt", std::time(nullptr) - 30 * 86400);
+      EXPECT_EQ(1, (uMode == 3) ? Directory::ApplyRetention(strPruneFolder, Policy, Options)
+         : Directory::CleanUpFiles(strPruneFolder, 5, Options));
+      EXPECT_FALSE(Directory::IsDirectory(strPruneFolder + "/D"));
+      EXPECT_TRUE(Directory::IsDirectory(strPruneFolder));
+      EXPECT_TRUE(fs::is_empty(strPruneFolder));
+
+      bool bSuccess = false;
+      Directory::EraseFolder(strPruneFolder, bSuccess);
+      ASSERT_TRUE(bSuccess);
+   }
+}
+
+TEST_F(HelpersTest, ThrottledRemovals)
+{
+   const std::string strThrottleFolder = TEST_FOLDER + "THROTTLE";
+   IoThrottle& Throttle = IoThrottle::GetInstance();
+   // expired files of 100 bytes
+   auto CreateFiles = [&](const size_t uCount)
+   {
+      ASSERT_TRUE(Directory::CreateDirectories(strThrottleFolder + "/sub"));
+      for (size_t uFile = 0; uFile < uCount; ++uFile)
+      {
+         const std::string strFile = strThrottleFolder + ((uFile % 2) ? "/sub" : "") + "/f" + std::to_string(uFile);
+         std::ofstream(strFile) << std::string(100, 'f');
+         fs::last_write_time(strFile, std::time(nullptr) - 30 * 86400);
+      }
+   };
+   auto ElapsedMilliseconds = [](const std::chrono::steady_clock::time_point tStart)
+   {
+      return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - tStart).count();
+   };
+
+   // no limit by default
+   Throttle.ResetCounters();
+   CreateFiles(40);
+   EXPECT_EQ(40, Directory::CleanUpFiles(strThrottleFolder, 5, true));
+   EXPECT_EQ(0, Throttle.GetThrottledCount());
+
+   // 1000 removals per second, the bucket being emptied first : 40 removals take 40 ms
+   // (the threads share the rate)
+   Directory::CleanUpOptions Options;
+   Options.bRecursive = true;
+   Options.uThreads = 4;
+   Throttle.SetLimits(1000, 0);
+   CreateFiles(40);
+   Throttle.Acquire(1000, 0);
+   std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+   EXPECT_EQ(40, Directory::CleanUpFiles(strThrottleFolder, 5, Options));
+   EXPECT_GE(ElapsedMilliseconds(tStart), 35);
+   EXPECT_GT(Throttle.GetThrottledCount(), 0);
+   EXPECT_GT(Throttle.GetThrottledNanoseconds(), 0ULL);
+
+   // 100 kB per second : the 2000 bytes of 20 files take 20 ms
+   Throttle.SetLimits(0, 100000);
+   Throttle.ResetCounters();
+   Options.bStreaming = true;
+   Options.uThreads = 1;
+   CreateFiles(20);
+   Throttle.Acquire(0, 100000);
+   tStart = std::chrono::steady_clock::now();
+   EXPECT_EQ(20, Directory::CleanUpFiles(strThrottleFolder, 5, Options));
+   EXPECT_GE(ElapsedMilliseconds(tStart), 15);
+   EXPECT_GT(Throttle.GetThrottledCount(), 0);
+
+   #ifdef LINUX
+   // the erase counts the folders too
+   Throttle.SetLimits(1000, 0);
+   CreateFiles(38);
+   Throttle.Acquire(1000, 0);
+   tStart = std::chrono::steady_clock::now();
+   bool bSuccess = false;
+   EXPECT_EQ(40, Directory::EraseFolder(strThrottleFolder, bSuccess, 4));
+   EXPECT_TRUE(bSuccess);
+   EXPECT_GE(ElapsedMilliseconds(tStart), 35);
+
+   // idle I/O priority for the removals only : the caller's priority is restored
+   Throttle.SetLimits(0, 0);
+   const long lPriority = syscall(SYS_ioprio_get, 1, 0);
+   Throttle.SetIdlePriority(true);
+   CreateFiles(10);
+   EXPECT_EQ(12, Directory::EraseFolder(strThrottleFolder, bSuccess, 4));
+   EXPECT_TRUE(bSuccess);
+   EXPECT_EQ(lPriority, syscall(SYS_ioprio_get, 1, 0));
+   Throttle.SetIdlePriority(false);
+   #endif
+
+   Throttle.SetLimits(0, 0);
+   Throttle.ResetCounters();
+   bool bErased = false;
+   Directory::EraseFolder(strThrottleFolder, bErased);
+   EXPECT_TRUE(bErased);
+}
+
+// run with --gtest_also_run_disabled_tests
+TEST_F(HelpersTest, DISABLED_BenchmarkCleanUp)
+{
+   const std::string strBenchFolder = TEST_FOLDER + "BENCH_CLEANUP/";
+   const size_t uFolders = 1000;
+   const size_t uFilesPerFolder = 1000;
+   const std::time_t tExpired = std::time(nullptr) - 30 * 86400;
+
+   // 0 : files listed then deleted, 1 : streaming, then parallel clean ups
+   for (size_t uThreads : { 0, 1, 4, 16 })
+   {
+      for (size_t uFolder = 0; uFolder < uFolders; ++uFolder)
+      {
+         const std::string strFolder = strBenchFolder + std::to_string(uFolder % 32) + "/" + std::to_string(uFolder) + "/";
+         ASSERT_TRUE(Directory::CreateDirectories(strFolder));
+         for (size_t uFile = 0; uFile < uFilesPerFolder; ++uFile)
+         {
+            const std::string strFile = strFolder + "file_" + std::to_string(uFile) + ".log";
+            std::ofstream(strFile) << "log";
+            fs::last_write_time(strFile, tExpired);
+         }
+      }
+
+      Directory::CleanUpOptions Options;
+      Options.bRecursive = true;
+      Options.bStreaming = (uThreads == 1);
+      Options.uThreads = (uThreads == 0) ? 1 : uThreads;
+      auto tStart = std::chrono::steady_clock::now();
+      const size_t uDeleted = Directory::CleanUpFiles(strBenchFolder, 5, Options);
+      auto tElapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - tStart);
+      EXPECT_EQ(uFolders * uFilesPerFolder, uDeleted);
+
+      std::cout << "[ BENCH    ] " << ((uThreads == 0) ? "listed" : (uThreads == 1) ? "streaming" : "parallel")
+         << ", " << Options.uThreads << " thread(s) : " << uDeleted << " files deleted in " << tElapsed.count() << " ms"
+         << std::endl;
+   }
+
+   bool bSuccess = false;
+   Directory::EraseFolder(strBenchFolder, bSuccess);
+   EXPECT_TRUE(bSuccess);
+}
+
+TEST_F(HelpersTest, FilteredListing)
+{
+   const std::string strFilterFolder = TEST_FOLDER + "FILTER";
+   ASSERT_TRUE(Directory::CreateDirectories(strFilterFolder + "/.git/objects"));
+   ASSERT_TRUE(Directory::CreateDirectories(strFilterFolder + "/src/node_modules/lib"));
+   ASSERT_TRUE(Directory::CreateDirectories(strFilterFolder + "/src/deep/deeper"));
+   std::ofstream(strFilterFolder + "/.git/objects/obj.txt") << "git";
+   std::ofstream(strFilterFolder + "/src/node_modules/lib/index.js") << "js";
+   std::ofstream(strFilterFolder + "/src/main.cpp") << "int main() { return 0; }";
+   std::ofstream(strFilterFolder + "/src/notes.txt") << "notes";
+   std::ofstream(strFilterFolder + "/src/log_01.txt") << "";
+   std::ofstream(strFilterFolder + "/src/deep/deeper/far.cpp") << "far";
+
+   Directory::WalkFilter Filter;
+   Filter.ExcludeFolder(".git").ExcludeFolder("node_*").AddExtension("cpp").AddPattern("log_??.*");
+
+   Directory FilteredDir;
+   FilteredDir.SetFilter(Filter);
+   for (size_t uThreads : { 1, 4 })
+   {
+      FilteredDir.SetThreadsCount(uThreads);
+      FilteredDir.ListTree(strFilterFolder, true, Directory::RELATIVE_PATH);
+      EXPECT_EQ(3, FilteredDir.GetFoldersCount()); // src, src/deep, src/deep/deeper
+      EXPECT_EQ(3, FilteredDir.GetFilesCount());
+      EXPECT_EQ(1, FilteredDir.GetMapFilesRelAbs().count("src/log_01.txt"));
+      EXPECT_EQ(1, FilteredDir.GetMapFilesRelAbs().count("src/deep/deeper/far.cpp"));
+      EXPECT_EQ(0, FilteredDir.GetMapFilesRelAbs().count("src/notes.txt"));
+   }
+
+   // the folders at the maximum depth are reported but not read
+   Filter.SetMaxDepth(2);
+   FilteredDir.SetFilter(Filter);
+   FilteredDir.ListTree(strFilterFolder, true);
+   EXPECT_EQ(2, FilteredDir.GetFoldersCount()); // src, src/deep
+   EXPECT_EQ(2, FilteredDir.GetFilesCount());   // src/main.cpp, src/log_01.txt
+
+   // empty files are out of the size range
+   Directory::WalkFilter SizeFilter;
+   SizeFilter.SetSizeRange(1).AddPattern("*.txt");
+   FilteredDir.SetFilter(SizeFilter);
+   FilteredDir.ListFiles(strFilterFolder, true);
+   EXPECT_EQ(2, FilteredDir.GetFilesCount()); // .git/objects/obj.txt, src/notes.txt
+
+   Directory::WalkFilter TimeFilter;
+   TimeFilter.SetModificationTimeRange(0, 1);
+   FilteredDir.SetFilter(TimeFilter);
+   FilteredDir.ListFiles(strFilterFolder, true);
+   EXPECT_EQ(0, FilteredDir.GetFilesCount());
+
+   bool bSuccess = false;
+   Directory::EraseFolder(strFilterFolder, bSuccess);
+   EXPECT_TRUE(bSuccess);
+}
+
+#ifdef LINUX
+TEST_F(HelpersTest, WatchedDirectory)
+{
+   const std::string strWatchedFolder = TEST_FOLDER + "WATCHED";
+   ASSERT_TRUE(Directory::CreateDirectories(strWatchedFolder + "/A"));
+   std::ofstream(strWatchedFolder + "/A/a.txt") << "a";
+
+   WatchedDirectory Watched;
+   ASSERT_TRUE(Watched.Start(strWatchedFolder));
+   EXPECT_TRUE(Watched.IsFolder("A"));
+   EXPECT_TRUE(Watched.IsFile("A/a.txt"));
+   EXPECT_EQ(strWatchedFolder + "/A/a.txt", Watched.GetMapFilesRelAbs().at("A/a.txt"));
+
+   // a new folder and its content, created before its watch exists
+   ASSERT_TRUE(Directory::CreateDirectories(strWatchedFolder + "/B/C"));
+   std::ofstream(strWatchedFolder + "/B/C/c.txt") << "c";
+   std::ofstream(strWatchedFolder + "/root.txt") << "root";
+   EXPECT_LT(0, Watched.ProcessEvents(1000));
+   EXPECT_TRUE(Watched.IsFolder("B/C"));
+   EXPECT_TRUE(Watched.IsFile("B/C/c.txt"));
+   EXPECT_TRUE(Watched.IsFile("root.txt"));
+
+   // moved subtree, still watched at its new location
+   ASSERT_TRUE(Directory::Rename(strWatchedFolder + "/B", strWatchedFolder + "/A/B"));
+   EXPECT_LT(0, Watched.ProcessEvents(1000));
+   EXPECT_FALSE(Watched.IsFolder("B"));
+   EXPECT_FALSE(Watched.IsFile("B/C/c.txt"));
+   EXPECT_TRUE(Watched.IsFile("A/B/C/c.txt"));
+
+   ASSERT_TRUE(Directory::EraseFile(strWatchedFolder + "/A/B/C/c.txt"));
+   EXPECT_LT(0, Watched.ProcessEvents(1000));
+   EXPECT_FALSE(Watched.IsFile("A/B/C/c.txt"));
+   EXPECT_EQ(3, Watched.GetFoldersCount());
+   EXPECT_EQ(2, Watched.GetFilesCount());
+
+   // no changes
+   EXPECT_EQ(0, Watched.ProcessEvents(0));
+
+   bool bSuccess = false;
+   Directory::EraseFolder(strWatchedFolder, bSuccess);
+   EXPECT_TRUE(bSuccess);
+   Watched.ProcessEvents(1000);
+   EXPECT_FALSE(Watched.IsStarted());
+   EXPECT_EQ(0, Watched.GetFilesCount());
+
+   // check for failure
+   EXPECT_FALSE(Watched.Start(strWatchedFolder));
+}
+#endif
+
 TEST_F(HelpersTest, ExtractFileDir)
 {
    std::string strFilePath = TEST_FOLDER + TEST_FILE;
@@ -226,6 +1573,152 @@ TEST_F(HelpersTest, DeleteDirs)
    EXPECT_EQ(1, usCount); // TODO : to be fixed according to the number of files present + the folder itself
 }
 
+TEST_F(HelpersTest, DeleteTree)
+{
+   const std::string strTreeFolder = TEST_FOLDER + "DELETE_TREE";
+   const std::string strOutsideFolder = TEST_FOLDER + "DELETE_TREE_OUTSIDE";
+   ASSERT_TRUE(Directory::CreateDirectories(strOutsideFolder));
+   std::ofstream(strOutsideFolder + "/kept.txt") << "kept";
+
+   // the same tree twice : the count of removed entries must be fs::remove_all's one
+   for (const char* pszSuffix : { "", "_BOOST" })
+   {
+      std::string strFolder = strTreeFolder + pszSuffix;
+      for (size_t uDepth = 0; uDepth < 24; ++uDepth)
+      {
+         strFolder += "/" + std::to_string(uDepth);
+         ASSERT_TRUE(Directory::CreateDirectories(strFolder));
+         std::ofstream(strFolder + "/file.txt") << "file";
+      }
+      fs::create_directory_symlink(strOutsideFolder, strTreeFolder + pszSuffix + "/link");
+   }
+
+   bool bSuccess = false;
+   EXPECT_EQ(fs::remove_all(strTreeFolder + "_BOOST"), Directory::EraseFolder(strTreeFolder, bSuccess));
+   EXPECT_TRUE(bSuccess);
+   EXPECT_FALSE(Directory::IsDirectory(strTreeFolder));
+   EXPECT_TRUE(Directory::IsFile(strOutsideFolder + "/kept.txt")); // symbolic links aren't followed
+
+   // a file is removed too
+   EXPECT_EQ(1, Directory::EraseFolder(strOutsideFolder + "/kept.txt", bSuccess));
+   EXPECT_TRUE(bSuccess);
+   EXPECT_EQ(1, Directory::EraseFolder(strOutsideFolder, bSuccess));
+   EXPECT_TRUE(bSuccess);
+}
+
+TEST_F(HelpersTest, DeleteTreeInParallel)
+{
+   const std::string strTreeFolder = TEST_FOLDER + "DELETE_PARALLEL";
+   for (const char* pszSuffix : { "", "_BOOST" })
+   {
+      for (size_t uFolder = 0; uFolder < 16; ++uFolder)
+      {
+         const std::string strFolder = strTreeFolder + pszSuffix + "/" + std::to_string(uFolder) + "/sub/subsub";
+         ASSERT_TRUE(Directory::CreateDirectories(strFolder));
+         for (size_t uFile = 0; uFile < 20; ++uFile)
+            std::ofstream(strFolder + "/../file_" + std::to_string(uFile) + ".txt") << "file";
+      }
+   }
+
+   for (size_t uThreads : { 2, 8 })
+   {
+      bool bSuccess = false;
+      EXPECT_EQ(fs::remove_all(strTreeFolder + "_BOOST"), Directory::EraseFolder(strTreeFolder, bSuccess, uThreads));
+      EXPECT_TRUE(bSuccess);
+      EXPECT_FALSE(Directory::IsDirectory(strTreeFolder));
+
+      // nothing left to remove
+      EXPECT_EQ(0, Directory::EraseFolder(strTreeFolder, bSuccess, uThreads));
+      EXPECT_TRUE(bSuccess);
+
+      ASSERT_TRUE(Directory::CreateDirectories(strTreeFolder + "/A/B"));
+      ASSERT_TRUE(Directory::CreateDirectories(strTreeFolder + "_BOOST/A/B"));
+   }
+   bool bSuccess = false;
+   EXPECT_EQ(3, Directory::EraseFolder(strTreeFolder, bSuccess, 4));
+   EXPECT_TRUE(bSuccess);
+   EXPECT_EQ(3, Directory::EraseFolder(strTreeFolder + "_BOOST", bSuccess));
+}
+
+TEST_F(HelpersTest, DeleteTreeAsync)
+{
+   const std::string strTreeFolder = TEST_FOLDER + "DELETE_ASYNC";
+   for (size_t uFolder = 0; uFolder < 8; ++uFolder)
+   {
+      const std::string strFolder = strTreeFolder + "/" + std::to_string(uFolder);
+      ASSERT_TRUE(Directory::CreateDirectories(strFolder));
+      for (size_t uFile = 0; uFile < 10; ++uFile)
+         std::ofstream(strFolder + "/file_" + std::to_string(uFile) + ".txt") << "file";
+   }
+
+   FolderReaper& Reaper = FolderReaper::GetInstance();
+   Reaper.Wait();
+   const size_t uRemovedBefore = Reaper.GetRemovedCount();
+
+   // the path is free at once
+   EXPECT_TRUE(Directory::EraseFolderAsync(strTreeFolder));
+   EXPECT_FALSE(Directory::IsDirectory(strTreeFolder));
+   ASSERT_TRUE(Directory::CreateDirectories(strTreeFolder));
+   Reaper.Wait();
+   EXPECT_EQ(0, Reaper.GetPendingCount());
+   EXPECT_EQ(uRemovedBefore + 89, Reaper.GetRemovedCount());
+
+   // the leftovers of a process which didn't finish are removed too
+   const std::vector<std::string> vecTrashes = Reaper.GetTrashes(TEST_FOLDER);
+   ASSERT_FALSE(vecTrashes.empty());
+   std::string strLeftover;
+   for (const std::string& strTrash : vecTrashes)
+      if (Directory::IsDirectory(strTrash))
+      {
+         strLeftover = strTrash + "/999999999_1";
+         break;
+      }
+   ASSERT_FALSE(strLeftover.empty());
+   ASSERT_TRUE(Directory::CreateDirectories(strLeftover + "/A"));
+   std::ofstream(strLeftover + "/A/file.txt") << "file";
+   EXPECT_EQ(1, Reaper.CollectLeftovers(TEST_FOLDER));
+   Reaper.Wait();
+   EXPECT_FALSE(Directory::IsDirectory(strLeftover));
+
+   // nothing to remove
+   EXPECT_TRUE(Directory::EraseFolderAsync(strTreeFolder));
+   EXPECT_TRUE(Directory::EraseFolderAsync(strTreeFolder));
+   Reaper.Wait();
+}
+
+// run with --gtest_also_run_disabled_tests
+TEST_F(HelpersTest, DISABLED_BenchmarkEraseFolder)
+{
+   const std::string strBenchFolder = TEST_FOLDER + "BENCH_ERASE/";
+   const size_t uFolders = 256;
+   const size_t uSubFolders = 8;
+   const size_t uFilesPerFolder = 64;
+
+   for (size_t uThreads = 1; uThreads <= 16; uThreads *= 2)
+   {
+      for (size_t uFolder = 0; uFolder < uFolders; ++uFolder)
+      {
+         for (size_t uSubFolder = 0; uSubFolder < uSubFolders; ++uSubFolder)
+         {
+            const std::string strFolder = strBenchFolder + std::to_string(uFolder) + "/" + std::to_string(uSubFolder) + "/";
+            ASSERT_TRUE(Directory::CreateDirectories(strFolder));
+            for (size_t uFile = 0; uFile < uFilesPerFolder; ++uFile)
+               std::ofstream ofsDummy(strFolder + "file_" + std::to_string(uFile) + ".txt");
+         }
+      }
+
+      bool bSuccess = false;
+      auto tStart = std::chrono::steady_clock::now();
+      const size_t uRemoved = Directory::EraseFolder(strBenchFolder, bSuccess, uThreads);
+      auto tElapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - tStart);
+      EXPECT_TRUE(bSuccess);
+      EXPECT_EQ(1 + uFolders * (1 + uSubFolders * (1 + uFilesPerFolder)), uRemoved);
+
+      std::cout << "[ BENCH    ] " << uThreads << " thread(s) : " << uRemoved << " entries removed in "
+         << tElapsed.count() << " ms" << std::endl;
+   }
+}
+
 // check for failure
 TEST_F(HelpersTest, DeleteInexistantFolder)
 {
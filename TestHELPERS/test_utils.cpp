@@ -174,6 +174,26 @@ std::string GetTimeStamp()
    return stream.str();
 }
 
+// unique relative paths (e.g. dir_3/dir_12/file_42.txt) with 0 to 7 folders
+std::vector<std::string> GeneratePaths(const size_t uCount)
+{
+   std::mt19937 Generator(42);
+   std::uniform_int_distribution<int> DepthDistribution(0, 7);
+   std::uniform_int_distribution<int> NameDistribution(0, 31);
+
+   std::vector<std::string> vecPaths;
+   vecPaths.reserve(uCount);
+   for (size_t uPath = 0; uPath < uCount; ++uPath)
+   {
+      std::string strPath;
+      for (int iDepth = DepthDistribution(Generator); iDepth > 0; --iDepth)
+         strPath += "dir_" + std::to_string(NameDistribution(Generator)) + "/";
+      strPath += "file_" + std::to_string(uPath) + ".txt";
+      vecPaths.push_back(strPath);
+   }
+   return vecPaths;
+}
+
 bool GetFileTime(const char* const & pszFilePath, time_t& tLastModificationTime)
 {
    FILE* pFile = fopen(pszFilePath, "rb");
@@ -3,6 +3,7 @@
 
 #include <algorithm>
 #include <cerrno>
+#include <chrono>
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
@@ -15,6 +16,7 @@
 #include <iterator>
 #include <memory>
 #include <mutex>
+#include <random>
 #include <streambuf>
 #include <string>
 #include <sstream>
@@ -41,14 +43,16 @@ int TestZipProgressCallback(double dFileSize, double dBytesCount);
 void TestZipErrorLogger(const std::string& strMsg);
 
 std::string GetTimeStamp();
+std::vector<std::string> GeneratePaths(const size_t uCount);
 bool GetFileTime(const char* const & pszFilePath, time_t& tLastModificationTime);
 
-template<typename K, typename E, typename C>
-bool AreMapsEqual(const std::map<K, E, C>& map, const std::unordered_map<K, E>& umap)
+// the sorted map (std::map or FlatSortedMap) and the hash map (std::unordered_map or FlatHashMap) hold the same pairs
+template<typename SortedMap, typename HashMap>
+bool AreMapsEqual(const SortedMap& map, const HashMap& umap)
 {
    return
       map.size() == umap.size() &&
-      std::all_of(map.cbegin(), map.cend(), [&](std::pair<K, E> item)
+      std::all_of(map.cbegin(), map.cend(), [&](const typename SortedMap::value_type& item)
    {
       auto iter = umap.find(item.first);
       return iter != umap.end() && iter->second == item.second;
@@ -56,4 +60,36 @@ bool AreMapsEqual(const std::map<K, E, C>& map, const std::unordered_map<K, E>&
    );
 }
 
+// Directory::SlashOccurrencesComparison before the separators counts were computed once per path
+struct LegacySlashOccurrencesComparison
+{
+   bool operator()(const std::string& strA, const std::string& strB) const
+   {
+      if ((strA.find_first_of('\\') != std::string::npos) || (strA.find_first_of('/') != std::string::npos))
+      {
+         if ((strB.find_first_of('\\') != std::string::npos) || (strB.find_first_of('/') != std::string::npos))
+         {
+            if ((std::count(strA.begin(), strA.end(), '\\') == std::count(strB.begin(), strB.end(), '\\')
+                 && std::count(strA.begin(), strA.end(), '\\') != 0)
+               || (std::count(strA.begin(), strA.end(), '/') == std::count(strB.begin(), strB.end(), '/')
+                 && std::count(strA.begin(), strA.end(), '/') != 0))
+               return strA < strB;
+            else if (strA.find_first_of('\\') != std::string::npos)
+               return (std::count(strA.begin(), strA.end(), '\\') < std::count(strB.begin(), strB.end(), '\\'));
+            else
+               return (std::count(strA.begin(), strA.end(), '/') < std::count(strB.begin(), strB.end(), '/'));
+         }
+         else
+            return false;
+      }
+      else if ((strB.find_first_of('\\') != std::string::npos) || (strB.find_first_of('/') != std::string::npos))
+         return true;
+
+      if (strA.length() == strB.length())
+         return strA < strB;
+
+      return (strA.length() < strB.length());
+   }
+};
+
 #endif